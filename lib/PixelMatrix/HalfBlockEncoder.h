@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief A console cell of two vertically stacked pixels, packed in 64 bits.
+ *
+ * Bits 0-23 hold the top color (0xRRGGBB), bits 24-47 the bottom color and
+ * bits 48-49 the glyph. The color of a transparent half is stored as 0, so two
+ * cells that look the same compare equal with a single 64-bit compare.
+ */
+struct HalfBlockCell {
+    enum Glyph : uint8_t {
+        kBlank, // both pixels transparent: " " on the default background
+        kUpper, // top pixel only: "▀" on the default background
+        kLower, // bottom pixel only: "▄" on the default background
+        kBoth,  // "▀" in the top color over the bottom color
+    };
+
+    // pre-encoded UTF-8 of each glyph
+    static constexpr const char* kGlyphBytes[4] = {" ", "▀", "▄", "▀"};
+    static constexpr uint8_t kGlyphLengths[4] = {1, 3, 3, 3};
+
+    constexpr HalfBlockCell() : bits{0} {}
+    constexpr HalfBlockCell(uint32_t top, bool top_enabled, uint32_t bottom, bool bottom_enabled)
+        : bits{(top_enabled ? uint64_t(top & 0xFFFFFF) : 0) | (bottom_enabled ? uint64_t(bottom & 0xFFFFFF) << 24 : 0) |
+               uint64_t(uint32_t(top_enabled) | uint32_t(bottom_enabled) << 1) << 48} {}
+
+    constexpr Glyph glyph() const { return Glyph(bits >> 48 & 3); }
+    constexpr uint32_t top() const { return uint32_t(bits & 0xFFFFFF); }
+    constexpr uint32_t bottom() const { return uint32_t(bits >> 24 & 0xFFFFFF); }
+
+    constexpr bool operator==(const HalfBlockCell& other) const { return bits == other.bits; }
+    constexpr bool operator!=(const HalfBlockCell& other) const { return bits != other.bits; }
+
+    uint64_t bits;
+};
+
+/**
+ * @brief Encodes half-block cells into console output.
+ *
+ * Every console cell shows two vertically stacked pixels: "▀" draws the top
+ * pixel as foreground over the bottom pixel as background, "▄" draws a lone
+ * bottom pixel, and transparent (alpha 0) pixels show the terminal's default
+ * background. Color escapes are only emitted where the colors change along a
+ * line, cells of a single color are drawn as spaces on that background, and
+ * runs of identical cells use the REP escape ("CSI n b") when the terminal
+ * supports it and it is shorter than repeating the glyph.
+ */
+class HalfBlockEncoder {
+public:
+    explicit HalfBlockEncoder(bool repeat = false) : repeat_{repeat} {}
+
+    // cell of a top pixel and the pixel below it (nullptr below the last row of an
+    // odd height); Pixel has r, g, b and a members
+    template<typename Pixel>
+    static inline constexpr HalfBlockCell makeCell(const Pixel& top, const Pixel* bottom) {
+        return bottom != nullptr ? HalfBlockCell(pack(top), top.a != 0, pack(*bottom), bottom->a != 0) : HalfBlockCell(pack(top), top.a != 0, 0, false);
+    }
+
+    // a line starts with the default colors
+    inline void beginLine() {
+        foreground_ = kDefaultColor;
+        background_ = kDefaultColor;
+    }
+
+    inline void putCell(HalfBlockCell cell, std::string& out) {
+        const HalfBlockCell::Glyph glyph = cell.glyph();
+        switch (glyph) {
+            case HalfBlockCell::kBoth:
+                if (cell.top() == cell.bottom()) {
+                    // a solid cell only needs its background
+                    setColor(background_, cell.top(), "\033[48;2;", out);
+                    out += ' ';
+                    return;
+                }
+                setColor(foreground_, cell.top(), "\033[38;2;", out);
+                setColor(background_, cell.bottom(), "\033[48;2;", out);
+                break;
+            case HalfBlockCell::kUpper:
+                setColor(foreground_, cell.top(), "\033[38;2;", out);
+                setDefaultBackground(out);
+                break;
+            case HalfBlockCell::kLower:
+                setColor(foreground_, cell.bottom(), "\033[38;2;", out);
+                setDefaultBackground(out);
+                break;
+            default:
+                // only the background of a blank is visible
+                setDefaultBackground(out);
+                break;
+        }
+        out.append(HalfBlockCell::kGlyphBytes[glyph], HalfBlockCell::kGlyphLengths[glyph]);
+    }
+
+    // 'count' copies of 'cell'
+    inline void putRun(HalfBlockCell cell, int count, std::string& out) {
+        putCell(cell, out);
+        if (--count == 0) return;
+        // the glyph putCell just appended
+        const bool solid = cell.glyph() == HalfBlockCell::kBoth && cell.top() == cell.bottom();
+        const std::size_t length = solid ? 1 : HalfBlockCell::kGlyphLengths[cell.glyph()];
+        std::size_t repeat_length = 3; // "\033[" n "b"
+        for (int n = count; n > 0; n /= 10) repeat_length++;
+        if (repeat_ && std::size_t(count) * length > repeat_length) {
+            out += "\033[";
+            appendDecimal(uint32_t(count), out);
+            out += 'b';
+            return;
+        }
+        char glyph[3];
+        out.copy(glyph, length, out.size() - length);
+        for (int i = 0; i < count; i++) out.append(glyph, length);
+    }
+
+    // clear from the cursor to the end of the line, to the default background
+    inline void eraseLine(std::string& out) {
+        setDefaultBackground(out);
+        out += "\033[K";
+    }
+
+    // restore the default colors at the end of a line
+    inline void endLine(std::string& out) {
+        if (foreground_ != kDefaultColor || background_ != kDefaultColor) out += "\033[39;49m";
+        beginLine();
+    }
+
+private:
+    // packed 0xRRGGBB, or kDefaultColor for the terminal default
+    static constexpr uint32_t kDefaultColor = 0xFFFFFFFFu;
+
+    template<typename Pixel>
+    static inline constexpr uint32_t pack(const Pixel& pixel) {
+        return uint32_t(pixel.r) << 16 | uint32_t(pixel.g) << 8 | uint32_t(pixel.b);
+    }
+
+    static inline void setColor(uint32_t& current, uint32_t color, const char* introducer, std::string& out) {
+        if (current == color) return;
+        current = color;
+        out += introducer;
+        appendDecimal(color >> 16, out);
+        out += ';';
+        appendDecimal((color >> 8) & 0xFF, out);
+        out += ';';
+        appendDecimal(color & 0xFF, out);
+        out += 'm';
+    }
+
+    inline void setDefaultBackground(std::string& out) {
+        if (background_ == kDefaultColor) return;
+        background_ = kDefaultColor;
+        out += "\033[49m";
+    }
+
+    // without going through std::to_string
+    static inline void appendDecimal(uint32_t value, std::string& out) {
+        if (value >= 10) appendDecimal(value / 10, out);
+        out += char('0' + value % 10);
+    }
+
+    bool repeat_;
+    // colors in effect on the current line
+    uint32_t foreground_ = kDefaultColor;
+    uint32_t background_ = kDefaultColor;
+};
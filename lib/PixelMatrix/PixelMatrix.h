@@ -1,166 +1,122 @@
 #pragma once
 
-#include "ConsoleColor.h"
+#include "HalfBlockEncoder.h"
+#include <cstddef>
 #include <ostream>
+#include <string>
+#include <vector>
 
+/**
+ * @brief A console image of half-block cells, two pixel rows per console line.
+ *
+ * Each cell is a packed HalfBlockCell (8 bytes for two pixels and their glyph),
+ * so comparing two frames costs one 64-bit compare per cell. write() emits every
+ * line; writeDelta() emits only the cells that differ from the matrix already on
+ * screen and moves the cursor over the rest. Runs of identical cells go to the
+ * encoder as one run, and blanks at the end of a line are erased with EL.
+ */
 class PixelMatrix {
 public:
-    struct UTF32 {
-        constexpr UTF32() : data{'\0', '\0', '\0', '\0'} {}
-        constexpr UTF32(const char* s) : data{s[0], s[1], s[2], '\0'} {}
-        friend std::ostream& operator<<(std::ostream& os, const UTF32& c) { return os << c.data; }
-        char data[4];
-    };
-
-    PixelMatrix(int rows, int cols) : rows_{rows}, cols_{cols} {
-        matrix_ = new ConsoleColor[rows * cols]{};
-        display_char_ = new UTF32[((rows + 1) >> 1) * cols]{};
-        for (int row = 0; row < rows; row++)
-            for (int col = 0; col < cols; col++) {
-                operator[](row)[col].mode = row & 1 ? ConsoleColor::kBackground : ConsoleColor::kForeground;
-                display_char(row, col) = "▀";
-
-                operator[](row)[col].mode = row & 1 ? ConsoleColor::kDefaultBackground : ConsoleColor::kDefaultForeground;
-                display_char(row, col) = " \0\0";
-            }
-    }
-
-    ~PixelMatrix() {
-        delete[] display_char_;
-        delete[] matrix_;
-    }
+    PixelMatrix(int rows, int cols) : rows_{rows}, cols_{cols}, lines_{(rows + 1) >> 1}, cells_(std::size_t(lines_) * cols) {}
 
     friend std::ostream& operator<<(std::ostream& os, const PixelMatrix& pm) {
-        constexpr ConsoleColor empty{};
-        for (int row = 0; row < pm.rows_ >> 1 << 1; row += 2) {
-            ConsoleColor prev_top_color = empty;
-            ConsoleColor prev_bottom_color = empty;
-            for (int col = 0; col < pm.cols_; col++) {
-                ConsoleColor top_color = pm[row][col];
-                ConsoleColor bottom_color = pm[row + 1][col];
-                if (top_color != prev_top_color) {
-                    os << top_color;
-                    prev_top_color = top_color;
-                }
-                if (bottom_color != prev_bottom_color) {
-                    os << bottom_color;
-                    prev_bottom_color = bottom_color;
-                }
-                os << pm.display_char(row, col);
-                // os << pm[row][col] << pm[row + 1][col] << pm.display_char(row, col);
-            }
-            os << empty << '\n';
-        }
-        if (pm.rows_ & 1) {
-            ConsoleColor prev_color = empty;
-            for (int col = 0; col < pm.cols_; col++) {
-                ConsoleColor color = pm[pm.rows_ - 1][col];
-                if (color != prev_color) {
-                    os << color;
-                    prev_color = color;
-                }
-                os << pm.display_char(pm.rows_ - 1, col);
-                // os << pm[pm.rows_ - 1][col] << pm.display_char(pm.rows_ - 1, col);
-            }
-            os << empty << '\n';
-        }
-        return os;
+        std::string out;
+        HalfBlockEncoder encoder;
+        pm.write(encoder, out);
+        return os.write(out.data(), out.size());
     }
 
-    inline constexpr ConsoleColor* operator[](int row) const {
-        return matrix_ + row * cols_;
+    // append every line, starting at the cursor; the cursor ends below the last line
+    inline void write(HalfBlockEncoder& encoder, std::string& out) const {
+        for (int index = 0; index < lines_; index++) {
+            const HalfBlockCell* cells = line(index);
+            const int blank_from = blankTailStart(cells);
+            writeRuns(encoder, cells, 0, blank_from, out);
+            if (blank_from < cols_) encoder.eraseLine(out);
+            encoder.endLine(out);
+            out += '\n';
+        }
     }
 
-    inline constexpr UTF32& display_char(int row, int col) const {
-        return display_char_[(row >> 1) * cols_ + col];
-    }
+    // append the cells that differ from 'shown', the matrix currently on screen at the
+    // cursor; the cursor ends below the last line, as after write()
+    inline void writeDelta(const PixelMatrix& shown, HalfBlockEncoder& encoder, std::string& out) const {
+        if (shown.rows_ != rows_ || shown.cols_ != cols_) {
+            write(encoder, out);
+            return;
+        }
+        int cursor_line = 0;
+        for (int index = 0; index < lines_; index++) {
+            const HalfBlockCell* cells = line(index);
+            const HalfBlockCell* shown_cells = shown.line(index);
+            int col = 0;
+            while (col < cols_ && cells[col] == shown_cells[col]) col++;
+            if (col == cols_) continue;
 
-    inline constexpr void enable(int row, int col) {
-        if (row == rows_ - 1 && rows_ & 1) {
-            // top half mode
-            auto& th_mode = operator[](row >> 1 << 1)[col].mode;
-            if (th_mode == ConsoleColor::kForeground) return;
-            th_mode = ConsoleColor::kForeground;
-            display_char(row, col) = "▀";
-        } else {
-            // top/bottom half mode
-            auto& th_mode = operator[](row >> 1 << 1)[col].mode;
-            auto& bh_mode = operator[]((row >> 1 << 1) + 1)[col].mode;
-            // top/bottom half enabled
-            bool th_enabled = th_mode == ConsoleColor::kForeground || th_mode == ConsoleColor::kBackground;
-            bool bh_enabled = bh_mode == ConsoleColor::kForeground || bh_mode == ConsoleColor::kBackground;
-            if ((row & 1) == 0) { // top half
-                if (th_enabled) return;
-                if (bh_enabled) {
-                    // "▄" -> "█"
-                    th_mode = ConsoleColor::kForeground;
-                    bh_mode = ConsoleColor::kBackground;
-                    display_char(row, col) = "▀";
-                } else {
-                    // " " -> "▀"
-                    th_mode = ConsoleColor::kForeground;
-                    display_char(row, col) = "▀";
+            // '\n' moves to the start of the next line
+            out.append(std::size_t(index - cursor_line), '\n');
+            cursor_line = index;
+            const int blank_from = blankTailStart(cells);
+            int cursor_col = 0;
+            while (col < cols_) {
+                if (col > cursor_col) {
+                    out += "\033[";
+                    out += std::to_string(col - cursor_col);
+                    out += 'C';
                 }
-            } else { // bottom half
-                if (bh_enabled) return;
-                if (th_enabled) {
-                    // "▀" -> "█"
-                    bh_mode = ConsoleColor::kBackground;
-                } else {
-                    // " " -> "▄"
-                    th_mode = ConsoleColor::kDefaultBackground;
-                    bh_mode = ConsoleColor::kForeground;
-                    display_char(row, col) = "▄";
+                if (col >= blank_from) {
+                    // the rest of the line is blank
+                    encoder.eraseLine(out);
+                    break;
                 }
+                const int begin = col;
+                while (col < blank_from && cells[col] != shown_cells[col]) col++;
+                writeRuns(encoder, cells, begin, col, out);
+                cursor_col = col;
+                while (col < cols_ && cells[col] == shown_cells[col]) col++;
             }
+            encoder.endLine(out);
         }
+        out.append(std::size_t(lines_ - cursor_line), '\n');
     }
-    inline constexpr void disable(int row, int col) {
-        if (row == rows_ - 1 && rows_ & 1) {
-            // top half mode
-            auto& th_mode = operator[](row >> 1 << 1)[col].mode;
-            if (th_mode != ConsoleColor::kForeground) return;
-            th_mode = ConsoleColor::kDefaultForeground;
-            display_char(row, col) = " \0\0";
-        } else {
-            // top/bottom half mode
-            auto& th_mode = operator[](row >> 1 << 1)[col].mode;
-            auto& bh_mode = operator[]((row >> 1 << 1) + 1)[col].mode;
-            // top/bottom half enabled
-            bool th_enabled = th_mode == ConsoleColor::kForeground || th_mode == ConsoleColor::kBackground;
-            bool bh_enabled = bh_mode == ConsoleColor::kForeground || bh_mode == ConsoleColor::kBackground;
-            if ((row & 1) == 0) { // top half
-                if (!th_enabled) return;
-                if (bh_enabled) {
-                    // "█" -> "▄"
-                    th_mode = ConsoleColor::kDefaultBackground;
-                    bh_mode = ConsoleColor::kForeground;
-                    display_char(row, col) = "▄";
-                } else {
-                    // "▀" -> " "
-                    th_mode = ConsoleColor::kDefaultForeground;
-                    display_char(row, col) = " \0\0";
-                }
-            } else { // bottom half
-                if (!bh_enabled) return;
-                if (th_enabled) {
-                    // "█" -> "▀"
-                    bh_mode = ConsoleColor::kDefaultBackground;
-                } else {
-                    // "▄" -> " "
-                    th_mode = ConsoleColor::kDefaultForeground;
-                    bh_mode = ConsoleColor::kDefaultBackground;
-                    display_char(row, col) = " \0\0";
-                }
-            }
+
+    // fill console line 'index' from two pixel rows (nullptr 'bottom' below the last row of
+    // an odd height); Pixel has r, g, b and a members, alpha 0 is transparent
+    template<typename Pixel>
+    inline void setLine(int index, const Pixel* top, const Pixel* bottom) {
+        HalfBlockCell* cells = line(index);
+        for (int col = 0; col < cols_; col++) {
+            cells[col] = HalfBlockEncoder::makeCell(top[col], bottom != nullptr ? bottom + col : nullptr);
         }
     }
 
+    // cells of console line 'index' (two pixel rows)
+    inline HalfBlockCell* line(int index) { return cells_.data() + std::size_t(index) * cols_; }
+    inline const HalfBlockCell* line(int index) const { return cells_.data() + std::size_t(index) * cols_; }
+
     inline constexpr int rows() const { return rows_; }
     inline constexpr int cols() const { return cols_; }
+    inline constexpr int lines() const { return lines_; }
 
 private:
-    int rows_, cols_;
-    ConsoleColor* matrix_;
-    UTF32* display_char_;
+    // column after the last non-blank cell, or cols_ when the blanks are cheaper
+    // to write than EL
+    inline int blankTailStart(const HalfBlockCell* cells) const {
+        int end = cols_;
+        while (end > 0 && cells[end - 1] == HalfBlockCell()) end--;
+        return cols_ - end > 3 ? end : cols_;
+    }
+
+    // cells [begin, end) of a line, identical neighbours as runs
+    static inline void writeRuns(HalfBlockEncoder& encoder, const HalfBlockCell* cells, int begin, int end, std::string& out) {
+        while (begin < end) {
+            int run = begin + 1;
+            while (run < end && cells[run] == cells[begin]) run++;
+            encoder.putRun(cells[begin], run - begin, out);
+            begin = run;
+        }
+    }
+
+    int rows_, cols_, lines_;
+    std::vector<HalfBlockCell> cells_;
 };
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Memory.hpp"
+
+#include <algorithm>
 #include <cstdint>
 #include <utility>
 #include <vector>
@@ -10,48 +13,133 @@
 
 namespace q3 {
 
+// rectangle of pixels with inclusive bounds; empty when min > max
+struct Rect {
+    int32_t min_x, min_y, max_x, max_y;
+
+    static constexpr Rect emptyRect() { return {0, 0, -1, -1}; }
+
+    constexpr bool empty() const { return min_x > max_x || min_y > max_y; }
+
+    constexpr Rect intersect(const Rect& other) const {
+        return {std::max(min_x, other.min_x), std::max(min_y, other.min_y), std::min(max_x, other.max_x), std::min(max_y, other.max_y)};
+    }
+
+    // smallest rectangle containing both (empty rectangles are ignored)
+    constexpr Rect unite(const Rect& other) const {
+        if (empty()) return other;
+        if (other.empty()) return *this;
+        return {std::min(min_x, other.min_x), std::min(min_y, other.min_y), std::max(max_x, other.max_x), std::max(max_y, other.max_y)};
+    }
+};
+
+// tag for buffers whose contents are written before they are read
+struct Uninitialized {};
+inline constexpr Uninitialized uninitialized{};
+
+// contiguous run of elements (a row, or part of one)
+template<typename T>
+class Span {
+public:
+    Span() : data_(nullptr), size_(0) {}
+    Span(T* data, size_t size) : data_(data), size_(size) {}
+
+    T& operator[](size_t i) const { return data_[i]; }
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+    T* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    T* data_;
+    size_t size_;
+};
+
+/**
+ * @brief 2D buffer of pixels (or samples) with a configurable row pitch.
+ *
+ * Rows are getPitch() elements apart; the padding after each row is never
+ * read by the engine. Storage starts on a 64-byte boundary, and a pitch from
+ * alignedPitch() keeps every row on one, so SIMD kernels can process whole
+ * rows with aligned loads. Buffers created without a pitch are tightly packed.
+ */
 template<typename T>
 class GraphicsBuffer {
 public:
-    GraphicsBuffer() : width_(0), height_(0), data_() {}
+    using Storage = std::vector<T, BufferAllocator<T>>;
+
+    static constexpr size_t row_alignment = 64;
+
+    // smallest pitch >= width that keeps rows 64-byte aligned
+    static constexpr size_t alignedPitch(uint32_t width) {
+        if (row_alignment % sizeof(T) != 0) return width;
+        constexpr size_t elements = row_alignment / sizeof(T);
+        return (width + elements - 1) / elements * elements;
+    }
+
+    GraphicsBuffer() : width_(0), height_(0), pitch_(0), data_() {}
     GraphicsBuffer(uint32_t width, uint32_t height) 
-        : width_(width), height_(height), data_(width * height, T()) {}
+        : width_(width), height_(height), pitch_(width), data_(width * height, T()) {}
+    // contents are unspecified (large buffers are not touched until first written)
+    GraphicsBuffer(uint32_t width, uint32_t height, Uninitialized)
+        : width_(width), height_(height), pitch_(width), data_(width * height) {}
+    GraphicsBuffer(uint32_t width, uint32_t height, size_t pitch, Uninitialized)
+        : width_(width), height_(height), pitch_(checkPitch(width, pitch)), data_(pitch * height) {}
+    GraphicsBuffer(uint32_t width, uint32_t height, size_t pitch, const T& value)
+        : width_(width), height_(height), pitch_(checkPitch(width, pitch)), data_(pitch * height, value) {}
     template<typename U>
     GraphicsBuffer(uint32_t width, uint32_t height, U&& value) 
-        : width_(width), height_(height), data_(width * height, std::forward<U>(value)) {}
+        : width_(width), height_(height), pitch_(width), data_(width * height, std::forward<U>(value)) {}
+    // copies 'data' into aligned storage (a std::vector uses a different allocator)
     GraphicsBuffer(const std::vector<T>& data, uint32_t width, uint32_t height)
-        : width_(width), height_(height), data_(data) {
+        : width_(width), height_(height), pitch_(width), data_(data.begin(), data.end()) {
         if (data_.size() != width * height) {
             throw std::invalid_argument("Data size does not match the specified width and height.");
         }
     }
-    GraphicsBuffer(std::vector<T>&& data, uint32_t width, uint32_t height)
-        : width_(width), height_(height), data_(std::move(data)) {
+    // takes ownership of 'data' without copying
+    GraphicsBuffer(Storage&& data, uint32_t width, uint32_t height)
+        : width_(width), height_(height), pitch_(width), data_(std::move(data)) {
         if (data_.size() != width * height) {
             throw std::invalid_argument("Data size does not match the specified width and height.");
         }
     }
 
-    T* operator[](uint32_t y) { return data_.data() + y * width_; }
-    const T* operator[](uint32_t y) const { return data_.data() + y * width_; }
+    T* operator[](uint32_t y) { return data_.data() + y * pitch_; }
+    const T* operator[](uint32_t y) const { return data_.data() + y * pitch_; }
+
+    Span<T> row(uint32_t y) { return Span<T>(data_.data() + y * pitch_, width_); }
+    Span<const T> row(uint32_t y) const { return Span<const T>(data_.data() + y * pitch_, width_); }
 
     template<typename U>
-    void setValue(uint32_t x, uint32_t y, U&& value) { data_.data()[x + width_ * y] = std::forward<U>(value); }
-    T& getValue(uint32_t x, uint32_t y) { return data_.data()[x + width_ * y]; }
-    const T& getValue(uint32_t x, uint32_t y) const { return data_.data()[x + width_ * y]; }
+    void setValue(uint32_t x, uint32_t y, U&& value) { data_.data()[x + pitch_ * y] = std::forward<U>(value); }
+    T& getValue(uint32_t x, uint32_t y) { return data_.data()[x + pitch_ * y]; }
+    const T& getValue(uint32_t x, uint32_t y) const { return data_.data()[x + pitch_ * y]; }
 
+    // fills the padding as well, which lets it run as one contiguous store
     template<typename U>
     void fill(U&& value) { std::fill(data_.begin(), data_.end(), std::forward<U>(value)); }
+    // sets every element, padding included, to all-zero bytes (large blocks
+    // return their pages to the OS rather than writing them)
+    void zero() { BufferAllocator<T>::zero(data_.data(), data_.size()); }
 
     uint32_t getWidth() const { return width_; }
     uint32_t getHeight() const { return height_; }
+    size_t getPitch() const { return pitch_; }
+    // rows are getPitch() elements apart
     T* getData() { return data_.data(); }
     const T* getData() const { return data_.data(); }
 
 protected:
+    static size_t checkPitch(uint32_t width, size_t pitch) {
+        if (pitch < width) { throw std::invalid_argument("Pitch is smaller than the width."); }
+        return pitch;
+    }
+
     uint32_t width_;
     uint32_t height_;
-    std::vector<T> data_;
+    size_t pitch_;
+    Storage data_;
 };
 
 template<typename T>
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Buffer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace q3 {
+
+/**
+ * @brief Recycles GraphicsBuffer storage between users of the same dimensions.
+ *
+ * acquire() hands out a buffer of the requested size. When the last shared_ptr
+ * to it is released, the buffer returns to the pool instead of being freed, so
+ * switching antialiasing modes back and forth, or running several rasterizers
+ * with the same targets, does not reallocate (and re-fault) large sample buffers.
+ *
+ * Rows are padded to GraphicsBuffer::alignedPitch(), so every row starts on a
+ * 64-byte boundary. Every acquired buffer is zero-filled, whether it is new or
+ * recycled; a large recycled buffer drops its pages, which are zero-filled again
+ * as they are first written, so nothing of its previous user leaks through. Up to
+ * max_cached_bytes of idle storage is kept; the oldest idle buffers are freed first.
+ * The pool is thread-safe, and buffers may outlive it.
+ */
+template<typename T>
+class GraphicsBufferPool {
+public:
+    explicit GraphicsBufferPool(size_t max_cached_bytes = size_t(256) << 20) : state_(std::make_shared<State>()) {
+        state_->max_cached_bytes = max_cached_bytes;
+    }
+
+    // pool shared by every rasterizer
+    static GraphicsBufferPool& global() {
+        static GraphicsBufferPool pool;
+        return pool;
+    }
+
+    inline std::shared_ptr<GraphicsBuffer<T>> acquire(uint32_t width, uint32_t height) {
+        std::unique_ptr<GraphicsBuffer<T>> buffer;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            auto& idle = state_->idle;
+            for (auto it = idle.begin(); it != idle.end(); ++it) {
+                if ((*it)->getWidth() == width && (*it)->getHeight() == height && (*it)->getPitch() == GraphicsBuffer<T>::alignedPitch(width)) {
+                    buffer = std::move(*it);
+                    idle.erase(it);
+                    state_->cached_bytes -= bufferBytes(*buffer);
+                    break;
+                }
+            }
+        }
+        if (!buffer) { buffer = std::make_unique<GraphicsBuffer<T>>(width, height, GraphicsBuffer<T>::alignedPitch(width), uninitialized); }
+        buffer->zero();
+
+        std::weak_ptr<State> weak_state = state_;
+        return std::shared_ptr<GraphicsBuffer<T>>(buffer.release(), [weak_state](GraphicsBuffer<T>* released) {
+            std::unique_ptr<GraphicsBuffer<T>> owned(released);
+            if (auto state = weak_state.lock()) { state->recycle(std::move(owned)); }
+        });
+    }
+
+    inline void setMaxCachedBytes(size_t max_cached_bytes) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->max_cached_bytes = max_cached_bytes;
+        state_->evict();
+    }
+
+    // free every idle buffer
+    inline void trim() { setMaxCachedBytes(0); }
+
+    inline size_t getCachedBytes() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->cached_bytes;
+    }
+
+private:
+    static size_t bufferBytes(const GraphicsBuffer<T>& buffer) {
+        return buffer.getPitch() * buffer.getHeight() * sizeof(T);
+    }
+
+    struct State {
+        std::mutex mutex;
+        std::deque<std::unique_ptr<GraphicsBuffer<T>>> idle;
+        size_t cached_bytes = 0;
+        size_t max_cached_bytes = 0;
+
+        void recycle(std::unique_ptr<GraphicsBuffer<T>> buffer) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cached_bytes += bufferBytes(*buffer);
+            idle.push_back(std::move(buffer));
+            evict();
+        }
+
+        // caller holds the mutex
+        void evict() {
+            while (cached_bytes > max_cached_bytes && !idle.empty()) {
+                cached_bytes -= bufferBytes(*idle.front());
+                idle.pop_front();
+            }
+        }
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+}
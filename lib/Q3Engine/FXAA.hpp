@@ -0,0 +1,185 @@
+#pragma once
+
+#include "RGBColor.hpp"
+#include "Buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace q3 {
+
+/**
+ * @brief Edge-detecting post-process antialiasing (FXAA) for a resolved color buffer.
+ *
+ * Every pixel whose luma differs strongly from its neighbours is classified as
+ * lying on a horizontal or vertical edge. The edge is followed in both directions
+ * to find its ends, and the pixel is blended with the neighbour across the edge
+ * by its estimated coverage. Isolated sub-pixel features are softened by the
+ * difference between the pixel and its 3x3 average.
+ *
+ * The pass only reads the output buffer, so it costs a few operations per pixel
+ * regardless of the geometry, and can follow any rasterizer antialiasing mode.
+ */
+class FXAA {
+public:
+    FXAA() : edge_threshold_(0.125f), edge_threshold_min_(0.0312f), subpixel_quality_(0.25f), edge_blend_(0.75f), search_steps_(12) {}
+
+    // minimum local contrast, relative to the brightest neighbour, for a pixel to be processed
+    void setEdgeThreshold(float threshold) { edge_threshold_ = threshold; }
+    // absolute contrast below which dark regions are left untouched
+    void setEdgeThresholdMin(float threshold) { edge_threshold_min_ = threshold; }
+    // amount of sub-pixel softening (0 disables it)
+    void setSubpixelQuality(float quality) { subpixel_quality_ = quality; }
+    // fraction of the estimated edge coverage that is blended in (1 for aliased input)
+    void setEdgeBlend(float blend) { edge_blend_ = blend; }
+    // tuning for aliased input (defaults), or a lighter pass for input whose edges already
+    // carry coverage (supersampled, or shaded analytically), which the full blend would overshoot
+    void setAntialiasedInput(bool antialiased) {
+        edge_blend_ = antialiased ? 0.25f : 0.75f;
+        subpixel_quality_ = antialiased ? 0.05f : 0.25f;
+    }
+    // maximum distance (pixels) followed along an edge in each direction
+    void setSearchSteps(int steps) { search_steps_ = std::max(1, steps); }
+
+    inline void apply(GraphicsBuffer<RGBColor>& buffer) {
+        apply(buffer, Rect{0, 0, static_cast<int32_t>(buffer.getWidth()) - 1, static_cast<int32_t>(buffer.getHeight()) - 1});
+    }
+
+    // process only the pixels inside 'rect' (neighbours outside it are still read)
+    inline void apply(GraphicsBuffer<RGBColor>& buffer, const Rect& rect) {
+        const int32_t width = static_cast<int32_t>(buffer.getWidth());
+        const int32_t height = static_cast<int32_t>(buffer.getHeight());
+        if (width < 2 || height < 2) return;
+        const Rect region = rect.intersect({0, 0, width - 1, height - 1});
+        if (region.empty()) return;
+
+        // keep the input rows the edge search can reach (tightly packed),
+        // since the output is written in place
+        const int32_t margin = search_steps_ + 1;
+        const Rect reach = Rect{region.min_x - margin, region.min_y - margin, region.max_x + margin, region.max_y + margin}.intersect({0, 0, width - 1, height - 1});
+        source_.resize(static_cast<size_t>(width) * height);
+        luma_.resize(source_.size());
+        for (int32_t y = reach.min_y; y <= reach.max_y; y++) {
+            Span<const RGBColor> row = static_cast<const GraphicsBuffer<RGBColor>&>(buffer).row(y);
+            std::copy(row.begin(), row.end(), source_.begin() + static_cast<size_t>(y) * width);
+            for (int32_t x = reach.min_x; x <= reach.max_x; x++) {
+                const RGBColor& c = source_[static_cast<size_t>(y) * width + x];
+                luma_[static_cast<size_t>(y) * width + x] = (c.r * 0.299f + c.g * 0.587f + c.b * 0.114f) * (1.0f / 255.0f);
+            }
+        }
+
+        // luma with clamp-to-edge addressing
+        auto luma = [&](int32_t x, int32_t y) {
+            x = std::clamp(x, 0, width - 1);
+            y = std::clamp(y, 0, height - 1);
+            return luma_[static_cast<size_t>(y) * width + x];
+        };
+
+        for (int32_t y = region.min_y; y <= region.max_y; y++) {
+            RGBColor* output_row = buffer[y];
+            for (int32_t x = region.min_x; x <= region.max_x; x++) {
+                float luma_m = luma(x, y);
+                float luma_n = luma(x, y - 1);
+                float luma_s = luma(x, y + 1);
+                float luma_w = luma(x - 1, y);
+                float luma_e = luma(x + 1, y);
+
+                // skip pixels without enough local contrast
+                float luma_max = std::max({luma_m, luma_n, luma_s, luma_w, luma_e});
+                float luma_min = std::min({luma_m, luma_n, luma_s, luma_w, luma_e});
+                float range = luma_max - luma_min;
+                if (range < std::max(edge_threshold_min_, luma_max * edge_threshold_)) continue;
+
+                float luma_nw = luma(x - 1, y - 1);
+                float luma_ne = luma(x + 1, y - 1);
+                float luma_sw = luma(x - 1, y + 1);
+                float luma_se = luma(x + 1, y + 1);
+
+                // sub-pixel softening from the contrast between the pixel and its neighbourhood
+                float luma_average = (2.0f * (luma_n + luma_s + luma_w + luma_e) + luma_nw + luma_ne + luma_sw + luma_se) / 12.0f;
+                float subpixel = std::clamp(std::abs(luma_average - luma_m) / range, 0.0f, 1.0f);
+                subpixel = subpixel * subpixel * (3.0f - 2.0f * subpixel);
+                subpixel = subpixel * subpixel * subpixel_quality_;
+
+                // edge orientation: a horizontal edge has a large vertical second derivative
+                float edge_horizontal = std::abs(luma_nw - 2.0f * luma_w + luma_sw) + 2.0f * std::abs(luma_n - 2.0f * luma_m + luma_s) +
+                                        std::abs(luma_ne - 2.0f * luma_e + luma_se);
+                float edge_vertical = std::abs(luma_nw - 2.0f * luma_n + luma_ne) + 2.0f * std::abs(luma_w - 2.0f * luma_m + luma_e) +
+                                      std::abs(luma_sw - 2.0f * luma_s + luma_se);
+                bool horizontal = edge_horizontal >= edge_vertical;
+
+                // the side of the edge with the steepest gradient
+                float luma_1 = horizontal ? luma_n : luma_w;
+                float luma_2 = horizontal ? luma_s : luma_e;
+                float gradient_1 = luma_1 - luma_m;
+                float gradient_2 = luma_2 - luma_m;
+                bool negative_side = std::abs(gradient_1) >= std::abs(gradient_2);
+                float gradient_scaled = 0.25f * std::max(std::abs(gradient_1), std::abs(gradient_2));
+                float luma_local_average = 0.5f * ((negative_side ? luma_1 : luma_2) + luma_m);
+
+                // normal (across the edge) and tangent (along the edge) steps
+                int32_t normal_x = horizontal ? 0 : (negative_side ? -1 : 1);
+                int32_t normal_y = horizontal ? (negative_side ? -1 : 1) : 0;
+                int32_t tangent_x = horizontal ? 1 : 0;
+                int32_t tangent_y = horizontal ? 0 : 1;
+
+                // luma halfway between the pixel row (or column) and the one across the edge
+                auto edge_luma = [&](int32_t i) {
+                    int32_t ex = x + tangent_x * i;
+                    int32_t ey = y + tangent_y * i;
+                    return 0.5f * (luma(ex, ey) + luma(ex + normal_x, ey + normal_y)) - luma_local_average;
+                };
+
+                // follow the edge until its luma leaves the local average in both directions
+                int32_t distance_1 = 1, distance_2 = 1;
+                float luma_end_1 = edge_luma(-1);
+                float luma_end_2 = edge_luma(1);
+                while (std::abs(luma_end_1) < gradient_scaled && distance_1 < search_steps_) {
+                    luma_end_1 = edge_luma(-++distance_1);
+                }
+                while (std::abs(luma_end_2) < gradient_scaled && distance_2 < search_steps_) {
+                    luma_end_2 = edge_luma(++distance_2);
+                }
+
+                // coverage of the pixel by the surface across the edge, from its position along the edge;
+                // only a step, where the edge leaves the pixel's side at the nearest end and not at the
+                // other, is a straight edge (a bump at both ends is a curve or a thin feature)
+                bool nearest_is_1 = distance_1 < distance_2;
+                bool center_smaller = luma_m < luma_local_average;
+                bool step_1 = (luma_end_1 < 0.0f) != center_smaller;
+                bool step_2 = (luma_end_2 < 0.0f) != center_smaller;
+                float edge_offset = 0.0f;
+                if ((nearest_is_1 ? step_1 && !step_2 : step_2 && !step_1)) {
+                    edge_offset = (0.5f - static_cast<float>(std::min(distance_1, distance_2)) / (distance_1 + distance_2)) * edge_blend_;
+                }
+
+                float weight = std::max(edge_offset, subpixel);
+                if (weight <= 0.0f) continue;
+                const RGBColor& own = source_[static_cast<size_t>(y) * width + x];
+                int32_t nx = std::clamp(x + normal_x, 0, width - 1);
+                int32_t ny = std::clamp(y + normal_y, 0, height - 1);
+                const RGBColor& other = source_[static_cast<size_t>(ny) * width + nx];
+                RGBColor& output = output_row[x];
+                output.r = static_cast<uint8_t>(own.r + (other.r - own.r) * weight + 0.5f);
+                output.g = static_cast<uint8_t>(own.g + (other.g - own.g) * weight + 0.5f);
+                output.b = static_cast<uint8_t>(own.b + (other.b - own.b) * weight + 0.5f);
+                output.a = static_cast<uint8_t>(own.a + (other.a - own.a) * weight + 0.5f);
+            }
+        }
+    }
+
+private:
+    float edge_threshold_;
+    float edge_threshold_min_;
+    float subpixel_quality_;
+    float edge_blend_;
+    int search_steps_;
+
+    // scratch copies of the input colors and their luma
+    std::vector<RGBColor> source_;
+    std::vector<float> luma_;
+};
+
+}
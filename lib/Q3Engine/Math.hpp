@@ -1,7 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cmath>
+#include <type_traits>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 namespace q3 {
 
@@ -401,6 +407,47 @@ template<typename T> constexpr Matrix4T<T> operator/(T scalar, const Matrix4T<T>
     };
 }
 
+#if defined(__SSE__)
+// SSE kernels for float matrices (these specializations are not constexpr)
+// every sum is accumulated in the same order as the scalar code, so the results are bit-identical
+template<> inline Matrix4T<float> Matrix4T<float>::dot(const Matrix4T<float>& other) const noexcept {
+    const __m128 b0 = _mm_loadu_ps(other.d_[0]);
+    const __m128 b1 = _mm_loadu_ps(other.d_[1]);
+    const __m128 b2 = _mm_loadu_ps(other.d_[2]);
+    const __m128 b3 = _mm_loadu_ps(other.d_[3]);
+    Matrix4T<float> result;
+    for (int i = 0; i < 4; i++) {
+        __m128 row = _mm_mul_ps(_mm_set1_ps(d_[i][0]), b0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(d_[i][1]), b1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(d_[i][2]), b2));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(d_[i][3]), b3));
+        _mm_storeu_ps(result.d_[i], row);
+    }
+    return result;
+}
+template<> inline Vector4T<float> Matrix4T<float>::dot(const Vector4T<float>& other) const noexcept {
+    const __m128 v = _mm_setr_ps(other.position.x, other.position.y, other.position.z, other.w);
+    __m128 p0 = _mm_mul_ps(_mm_loadu_ps(d_[0]), v);
+    __m128 p1 = _mm_mul_ps(_mm_loadu_ps(d_[1]), v);
+    __m128 p2 = _mm_mul_ps(_mm_loadu_ps(d_[2]), v);
+    __m128 p3 = _mm_mul_ps(_mm_loadu_ps(d_[3]), v);
+    // lane i of pk becomes the k-th product of row i
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    alignas(16) float r[4];
+    _mm_store_ps(r, _mm_add_ps(_mm_add_ps(_mm_add_ps(p0, p1), p2), p3));
+    return {r[0], r[1], r[2], r[3]};
+}
+template<> inline Vector4T<float> Vector4T<float>::dot(const Matrix4T<float>& other) const noexcept {
+    __m128 v = _mm_mul_ps(_mm_set1_ps(position.x), _mm_loadu_ps(other[0]));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(position.y), _mm_loadu_ps(other[1])));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(position.z), _mm_loadu_ps(other[2])));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(w), _mm_loadu_ps(other[3])));
+    alignas(16) float r[4];
+    _mm_store_ps(r, v);
+    return {r[0], r[1], r[2], r[3]};
+}
+#endif
+
 using Vector2 = Vector2T<float>;
 using Vector3 = Vector3T<float>;
 using Vector4 = Vector4T<float>;
@@ -422,6 +469,105 @@ public:
     constexpr Vertex& operator=(const Vector4& other) noexcept { position.x = other.position.x; position.y = other.position.y; position.z = other.position.z; w = other.w; return *this; }
 };
 
+/**
+ * @brief 2D affine transform with an independent z scale and offset.
+ *
+ * Maps (x, y, z) to (xx * x + xy * y + tx, yx * x + yy * y + ty, zz * z + tz): a 2x3
+ * matrix in the xy plane, which is all a flat scene needs. Composition costs 14
+ * multiplies instead of the 64 of a Matrix4 product, and toMatrix4() converts to a
+ * full matrix only where one is required (e.g. a shader transform).
+ */
+template<typename T>
+class Affine2DT {
+public:
+    constexpr Affine2DT() noexcept : xx(1), xy(), yx(), yy(1), tx(), ty(), zz(1), tz() {}
+    constexpr Affine2DT(T xx, T xy, T yx, T yy, T tx, T ty, T zz = T(1), T tz = T()) noexcept
+        : xx(xx), xy(xy), yx(yx), yy(yy), tx(tx), ty(ty), zz(zz), tz(tz) {}
+
+    // composition: this.dot(other) applies 'other' first, like Matrix4T::dot
+    constexpr Affine2DT<T> dot(const Affine2DT<T>& other) const noexcept {
+        return {
+            xx * other.xx + xy * other.yx, xx * other.xy + xy * other.yy,
+            yx * other.xx + yy * other.yx, yx * other.xy + yy * other.yy,
+            xx * other.tx + xy * other.ty + tx, yx * other.tx + yy * other.ty + ty,
+            zz * other.zz, zz * other.tz + tz
+        };
+    }
+    // transform a point
+    constexpr Vector3T<T> dot(const Vector3T<T>& point) const noexcept {
+        return {xx * point.x + xy * point.y + tx, yx * point.x + yy * point.y + ty, zz * point.z + tz};
+    }
+    // comparison
+    constexpr bool operator==(const Affine2DT<T>& other) const noexcept {
+        return xx == other.xx && xy == other.xy && yx == other.yx && yy == other.yy && tx == other.tx && ty == other.ty && zz == other.zz && tz == other.tz;
+    }
+
+    constexpr Matrix4T<T> toMatrix4() const noexcept {
+        return {
+            {xx, xy, T(), tx},
+            {yx, yy, T(), ty},
+            {T(), T(), zz, tz},
+            {T(), T(), T(), T(1)}
+        };
+    }
+
+    T xx, xy, yx, yy;
+    T tx, ty;
+    T zz, tz;
+};
+
+using Affine2D = Affine2DT<float>;
+
+// transform 'count' points (w = 1) by 'matrix': out[i] = matrix * points[i]
+// Point is Vertex (keeps w) or Vector3 (position only); 'out' may alias 'points'
+template<typename Point>
+inline void transformPoints(const Matrix4& matrix, const Vector3* points, Point* out, size_t count) noexcept {
+    static_assert(std::is_same_v<Point, Vertex> || std::is_same_v<Point, Vector3>, "points transform into Vertex or Vector3");
+#if defined(__SSE__)
+    // the matrix is transposed once for the whole batch
+    __m128 c0 = _mm_loadu_ps(matrix[0]);
+    __m128 c1 = _mm_loadu_ps(matrix[1]);
+    __m128 c2 = _mm_loadu_ps(matrix[2]);
+    __m128 c3 = _mm_loadu_ps(matrix[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    for (size_t i = 0; i < count; i++) {
+        const Vector3 p = points[i];
+        __m128 v = _mm_mul_ps(c0, _mm_set1_ps(p.x));
+        v = _mm_add_ps(v, _mm_mul_ps(c1, _mm_set1_ps(p.y)));
+        v = _mm_add_ps(v, _mm_mul_ps(c2, _mm_set1_ps(p.z)));
+        v = _mm_add_ps(v, c3);
+        alignas(16) float r[4];
+        _mm_store_ps(r, v);
+        if constexpr (std::is_same_v<Point, Vertex>) {
+            out[i] = Vertex(r[0], r[1], r[2], r[3]);
+        } else {
+            out[i] = Vector3(r[0], r[1], r[2]);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        Vertex v = matrix.dot(Vertex(points[i]));
+        if constexpr (std::is_same_v<Point, Vertex>) {
+            out[i] = v;
+        } else {
+            out[i] = v.position;
+        }
+    }
+#endif
+}
+// transform 'count' points by an affine transform; 'out' may alias 'points'
+inline void transformPoints(const Affine2D& transform, const Vector3* points, Vector3* out, size_t count) noexcept {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = transform.dot(points[i]);
+    }
+}
+// transform a whole point buffer (e.g. DataBuffer<Vector3>) into 'out', resized to match
+template<typename Transform, typename Points, typename Output>
+inline void transformPoints(const Transform& transform, const Points& points, Output& out) {
+    out.resize(points.size());
+    transformPoints(transform, points.data(), out.data(), points.size());
+}
+
 constexpr float degToRad(float deg) {
     constexpr float PI = 3.14159265358979323846f;
     return deg * PI / 180.0f;
@@ -531,6 +677,30 @@ constexpr Matrix4 createTranslationMatrix(Vector3 translation) {
     return matrix;
 }
 
+constexpr Affine2D createScaleAffine(Vector3 scale) {
+    return {scale.x, 0.0f, 0.0f, scale.y, 0.0f, 0.0f, scale.z, 0.0f};
+}
+
+// rotation around +z from a precomputed cos / sin pair (a unit direction)
+constexpr Affine2D createRotationZAffine(float c, float s) {
+    return {c, -s, s, c, 0.0f, 0.0f};
+}
+inline Affine2D createRotationZAffine(float angle) {
+    return createRotationZAffine(std::cos(angle), std::sin(angle));
+}
+
+constexpr Affine2D createTranslationAffine(Vector3 translation) {
+    return {1.0f, 0.0f, 0.0f, 1.0f, translation.x, translation.y, 1.0f, translation.z};
+}
+
+// scale, then rotate around +z by (c, s), then translate, without intermediate products
+constexpr Affine2D createTransformAffine(Vector3 scale, float c, float s, Vector3 translation) {
+    return {c * scale.x, -s * scale.y, s * scale.x, c * scale.y, translation.x, translation.y, scale.z, translation.z};
+}
+inline Affine2D createTransformAffine(Vector3 scale, float angle, Vector3 translation) {
+    return createTransformAffine(scale, std::cos(angle), std::sin(angle), translation);
+}
+
 constexpr void createPerspectiveProjectionMatrix(Matrix4& matrix, float fov, float aspect, float near, float far) {
     float tanhf = std::tan(fov / 2.0f);
     float range = far - near;
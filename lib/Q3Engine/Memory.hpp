@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace q3 {
+
+/**
+ * @brief Storage allocator for pixel buffers.
+ *
+ * Blocks of at least large_block_size bytes are mapped directly from the OS
+ * (Linux): their pages are zero-filled lazily on first touch, aligned to and
+ * advised for transparent huge pages, so a large SSAA target costs a handful of
+ * page faults instead of one per 4 KiB page. Smaller blocks use operator new.
+ * Every block starts on a 64-byte (cache line) boundary.
+ *
+ * Value-initialization without arguments is skipped for trivially copyable
+ * elements, so a buffer created uninitialized touches none of its pages.
+ * zero() clears a block to all-zero bytes; mapped blocks drop their pages
+ * instead, so they are zero-filled again on first touch.
+ */
+template<typename T>
+class BufferAllocator {
+public:
+    using value_type = T;
+
+    static constexpr size_t large_block_size = size_t(2) << 20;
+    static constexpr size_t alignment = 64;
+
+    BufferAllocator() noexcept = default;
+    template<typename U>
+    BufferAllocator(const BufferAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= large_block_size) {
+            return static_cast<T*>(mapLarge(bytes));
+        }
+#endif
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(std::max(alignment, alignof(T)))));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= large_block_size) {
+            munmap(p, roundUp(bytes, page_size));
+            return;
+        }
+#endif
+        ::operator delete(p, std::align_val_t(std::max(alignment, alignof(T))));
+    }
+
+    // set the n elements at p (a block from allocate(n)) to all-zero bytes
+    static void zero(T* p, size_t n) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>, "zero() needs trivially copyable elements");
+        size_t bytes = n * sizeof(T);
+#if defined(__linux__) && defined(MADV_DONTNEED)
+        if (bytes >= large_block_size && madvise(p, roundUp(bytes, page_size), MADV_DONTNEED) == 0) {
+            return;
+        }
+#endif
+        std::memset(static_cast<void*>(p), 0, bytes);
+    }
+
+    template<typename U>
+    void construct(U* p) {
+        if constexpr (!std::is_trivially_copyable_v<U>) { ::new (static_cast<void*>(p)) U(); }
+    }
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    bool operator==(const BufferAllocator<U>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const BufferAllocator<U>&) const noexcept { return false; }
+
+private:
+    static constexpr size_t page_size = 4096;
+
+    static constexpr size_t roundUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+#if defined(__linux__)
+    // map 'bytes' aligned to large_block_size, trimming the over-allocated head and tail
+    static void* mapLarge(size_t bytes) {
+        size_t length = roundUp(bytes, page_size);
+        size_t mapped = length + large_block_size;
+        void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) throw std::bad_alloc();
+
+        uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = roundUp(begin, large_block_size);
+        if (aligned > begin) munmap(raw, aligned - begin);
+        uintptr_t end = begin + mapped;
+        if (end > aligned + length) munmap(reinterpret_cast<void*>(aligned + length), end - (aligned + length));
+#if defined(MADV_HUGEPAGE)
+        madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+#endif
+        return reinterpret_cast<void*>(aligned);
+    }
+#endif
+};
+
+}
@@ -1,13 +1,23 @@
 #pragma once
 
 #include "Buffer.hpp"
+#include "BufferPool.hpp"
 #include "RGBColor.hpp"
 #include "Math.hpp"
 #include "Shader.hpp"
 
 #include <algorithm>
+#include <initializer_list>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #ifdef _WIN32
 #include <malloc.h>
@@ -19,25 +29,84 @@ namespace q3 {
 
 class Rasterizer {
 public:
+    // SSAA_NX stores N samples per pixel placed on a rotated-grid (4x) or
+    // sparse (2x, 8x, 16x) pattern, so memory and fill cost grow linearly with N
+    // MSAA_NX uses the same samples for coverage and depth, but runs the fragment
+    // shader once per pixel and triangle and stores the color in every covered sample
     enum class AA_MODE {
         NONE,
         SSAA_2X,
         SSAA_4X,
         SSAA_8X,
-        SSAA_16X
+        SSAA_16X,
+        MSAA_2X,
+        MSAA_4X,
+        MSAA_8X,
+        MSAA_16X
+    };
+
+    // storage of the color samples of antialiased targets (NONE always draws
+    // straight into the interleaved output framebuffer)
+    enum class SampleLayout {
+        INTERLEAVED, // the RGBA samples of a pixel are stored next to each other
+        PLANAR,      // separate R, G, B and A planes: channel sums need no shuffles
+        TILED        // interleaved samples of 8x8-pixel tiles in Z (Morton) order
+    };
+
+    // storage of the depth samples of antialiased targets (NONE always tests the
+    // float output depthbuffer)
+    enum class DepthFormat {
+        FLOAT32, // full precision
+        UNORM16  // 16-bit fixed point: half the depth bandwidth, enough for a few layers
+    };
+
+    // triangle orientation discarded by drawTriangle; front faces are
+    // counter-clockwise in NDC (clockwise on screen, whose y axis points down)
+    enum class CullMode {
+        NONE,
+        BACK,
+        FRONT
+    };
+
+    enum class BlendMode {
+        ALPHA,  // source-over blending in exact integer arithmetic (opaque sources are written directly)
+        REPLACE // write the source color without reading the target (opaque geometry)
+    };
+
+    // per-draw pipeline state
+    // samples with a source alpha of 0 are discarded in every blend mode
+    struct DrawState {
+        bool depth_test = true;  // discard samples behind the depth buffer
+        bool depth_write = true; // store the depth of opaque samples
+        BlendMode blend_mode = BlendMode::ALPHA;
+        CullMode cull_mode = CullMode::NONE;
+        bool scissor_test = false; // restrict draws to the 'scissor' pixel rectangle
+        Rect scissor = Rect::emptyRect();
+    };
+
+    // triangles handled by drawTriangle since the last resetTriangleStats()
+    // (the triangles cut from a clipped one are set up, and counted, separately)
+    struct TriangleStats {
+        uint64_t submitted = 0;   // passed to drawTriangle
+        uint64_t rejected = 0;    // entirely outside the view volume
+        uint64_t clipped = 0;     // crossing a clip plane
+        uint64_t degenerate = 0;  // zero area on screen
+        uint64_t face_culled = 0; // discarded by the cull mode
     };
 
 public:
-    Rasterizer(std::shared_ptr<GraphicsBuffer<RGBColor>> framebuffer, std::shared_ptr<GraphicsBuffer<float>> depthbuffer)
-        : target_framebuffer_ptr_(nullptr), target_depthbuffer_ptr_(nullptr),
-          aa_mode_(AA_MODE::NONE) {
+    // depthbuffer may be nullptr for scenes drawn in painter's order: no depth
+    // storage is allocated, cleared, tested or resolved
+    Rasterizer(std::shared_ptr<GraphicsBuffer<RGBColor>> framebuffer, std::shared_ptr<GraphicsBuffer<float>> depthbuffer = nullptr)
+        : target_framebuffer_ptr_(nullptr), target_depthbuffer_ptr_(nullptr), target_depthbuffer16_ptr_(nullptr),
+          target_layout_(SampleLayout::INTERLEAVED), tile_columns_(0), sample_count_(1), sample_shift_(0), sample_offsets_(getSamplePattern(1)), aa_mode_(AA_MODE::NONE),
+          sample_layout_(SampleLayout::INTERLEAVED), depth_format_(DepthFormat::FLOAT32), guard_band_(4.0f), clip_mapping_(nullptr), dirty_rect_(Rect::emptyRect()) {
         setBuffers(framebuffer, depthbuffer);
     }
 
-    inline void setBuffers(std::shared_ptr<GraphicsBuffer<RGBColor>> framebuffer, std::shared_ptr<GraphicsBuffer<float>> depthbuffer) {
+    inline void setBuffers(std::shared_ptr<GraphicsBuffer<RGBColor>> framebuffer, std::shared_ptr<GraphicsBuffer<float>> depthbuffer = nullptr) {
         if (framebuffer == nullptr) { throw std::runtime_error("framebuffer is nullptr"); }
-        if (depthbuffer == nullptr) { throw std::runtime_error("depthbuffer is nullptr"); }
-        if (framebuffer->getWidth() != depthbuffer->getWidth() || framebuffer->getHeight() != depthbuffer->getHeight()) {
+        if (depthbuffer != nullptr && (framebuffer->getWidth() != depthbuffer->getWidth() || framebuffer->getHeight() != depthbuffer->getHeight())) {
             throw std::runtime_error("framebuffer and depthbuffer have different sizes");
         }
         framebuffer_ = framebuffer;
@@ -49,18 +118,155 @@ public:
     std::shared_ptr<GraphicsBuffer<float>> getDepthbuffer() const { return depthbuffer_; }
 
     inline void clearFrameBuffer(const RGBColor& color = RGBColor(0, 0, 0, 0)) {
+        if (target_layout_ == SampleLayout::PLANAR) {
+            // each plane is one contiguous block (padding included)
+            const uint8_t channels[4] = {color.r, color.g, color.b, color.a};
+            GraphicsBuffer<uint8_t>& planes = *super_sample_planes_;
+            const size_t plane_size = planes.getPitch() * framebuffer_->getHeight();
+            for (uint32_t c = 0; c < 4; c++) {
+                std::memset(planes.getData() + c * plane_size, channels[c], plane_size);
+            }
+            return;
+        }
         target_framebuffer_ptr_->fill(color);
     }
     inline void clearDepthBuffer(float value = 1.0f) {
-        target_depthbuffer_ptr_->fill(value);
+        if (target_depthbuffer16_ptr_ != nullptr) {
+            target_depthbuffer16_ptr_->fill(encodeDepth<uint16_t>(value));
+        } else if (target_depthbuffer_ptr_ != nullptr) {
+            target_depthbuffer_ptr_->fill(value);
+        } else {
+            return;
+        }
+        const float stored = storedDepth(value);
+        std::fill(depth_tiles_.begin(), depth_tiles_.end(), DepthTile{stored, stored, false});
+    }
+
+    // clear every sample of the output pixels inside 'rect'
+    inline void clearFrameBuffer(const RGBColor& color, const Rect& rect) {
+        if (target_layout_ == SampleLayout::PLANAR) {
+            const uint8_t channels[4] = {color.r, color.g, color.b, color.a};
+            const uint32_t height = framebuffer_->getHeight();
+            for (uint32_t c = 0; c < 4; c++) {
+                clearRegion(*super_sample_planes_, channels[c], rect, c * height);
+            }
+            return;
+        }
+        if (target_layout_ == SampleLayout::TILED) {
+            Rect clipped = rect.intersect(getViewportRect());
+            if (clipped.empty()) return;
+            const uint32_t n_samples = sample_count_;
+            for (int32_t y = clipped.min_y; y <= clipped.max_y; y++) {
+                const TiledRow row = getColorRow<TiledRow>(y);
+                for (int32_t x = clipped.min_x; x <= clipped.max_x; x++) {
+                    RGBColor* samples = &row.at(x * n_samples);
+                    std::fill(samples, samples + n_samples, color);
+                }
+            }
+            return;
+        }
+        clearRegion(*target_framebuffer_ptr_, color, rect);
+    }
+    inline void clearDepthBuffer(float value, const Rect& rect) {
+        if (target_depthbuffer16_ptr_ != nullptr) {
+            clearRegion(*target_depthbuffer16_ptr_, encodeDepth<uint16_t>(value), rect);
+        } else if (target_depthbuffer_ptr_ != nullptr) {
+            clearRegion(*target_depthbuffer_ptr_, value, rect);
+        } else {
+            return;
+        }
+        const float stored = storedDepth(value);
+        updateDepthTiles(rect.intersect(getViewportRect()), stored, stored, true);
     }
 
+    // the depth buffer was written outside of the rasterizer (e.g. through
+    // getDepthbuffer()): forget the depth bounds of the hierarchical depth tiles
+    inline void invalidateDepthTiles() { resetDepthTiles(); }
+
+    // output pixel rectangle covering the whole framebuffer
+    inline Rect getViewportRect() const {
+        return {0, 0, static_cast<int32_t>(framebuffer_->getWidth()) - 1, static_cast<int32_t>(framebuffer_->getHeight()) - 1};
+    }
+
+    // union of the output pixel rectangles touched by draws since the last reset
+    // (bounding boxes after clipping to the viewport and scissor)
+    const Rect& getDirtyRect() const { return dirty_rect_; }
+    inline void resetDirtyRect() { dirty_rect_ = Rect::emptyRect(); }
+
+    inline void setDrawState(const DrawState& state) { draw_state_ = state; }
+    const DrawState& getDrawState() const { return draw_state_; }
+
+    const TriangleStats& getTriangleStats() const { return triangle_stats_; }
+    inline void resetTriangleStats() { triangle_stats_ = TriangleStats{}; }
+
     inline void setAntialiasingMode(AA_MODE mode) {
         aa_mode_ = mode;
         updateSuperSampleBuffers();
     }
+    AA_MODE getAntialiasingMode() const { return aa_mode_; }
+
+    // the contents of the sample target are unspecified after a layout change
+    inline void setSampleLayout(SampleLayout layout) {
+        sample_layout_ = layout;
+        updateSuperSampleBuffers();
+    }
+    SampleLayout getSampleLayout() const { return sample_layout_; }
+
+    // the contents of the sample depth target are unspecified after a format change
+    inline void setDepthFormat(DepthFormat format) {
+        depth_format_ = format;
+        updateSuperSampleBuffers();
+    }
+    DepthFormat getDepthFormat() const { return depth_format_; }
+
+    // triangles are clipped against x, y = +-guard_band * w (NDC units, at least 1);
+    // inside the band only the bounding box is clamped to the viewport
+    inline void setGuardBand(float guard_band) { guard_band_ = std::max(1.0f, guard_band); }
+    float getGuardBand() const { return guard_band_; }
+
+    // number of samples per output pixel
+    // every pattern places its samples on distinct rows and columns, so this is
+    // also the number of distinct edge positions along each axis of a pixel
+    inline uint32_t getSampleCount() const {
+        switch (aa_mode_) {
+        case AA_MODE::SSAA_2X:
+        case AA_MODE::MSAA_2X: return 2;
+        case AA_MODE::SSAA_4X:
+        case AA_MODE::MSAA_4X: return 4;
+        case AA_MODE::SSAA_8X:
+        case AA_MODE::MSAA_8X: return 8;
+        case AA_MODE::SSAA_16X:
+        case AA_MODE::MSAA_16X: return 16;
+        case AA_MODE::NONE:
+        default: return 1;
+        }
+    }
+
+    // whether fragments are shaded once per pixel instead of once per sample
+    inline bool isMultisampled() const {
+        return aa_mode_ == AA_MODE::MSAA_2X || aa_mode_ == AA_MODE::MSAA_4X || aa_mode_ == AA_MODE::MSAA_8X || aa_mode_ == AA_MODE::MSAA_16X;
+    }
 
     inline void drawBuffer(const DataBuffer<Vector3>& vertices, const DataBuffer<uint32_t>& indices, Shader& shader, BaseDataBufferSampler& sampler) {
+        // shaders with a per-vertex stage transform every vertex once, instead of
+        // once per triangle that shares it
+        transformed_vertices_.resize(vertices.size());
+        if (shader.transformVertices(vertices.data(), transformed_vertices_.data(), vertices.size())) {
+            const size_t context_size = shader.getContextSize();
+            void* context = alloca(context_size);
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                uint32_t i0 = indices[i];
+                uint32_t i1 = indices[i + 1];
+                uint32_t i2 = indices[i + 2];
+                void* data0 = sampler.getValue(i0);
+                void* data1 = sampler.getValue(i1);
+                void* data2 = sampler.getValue(i2);
+                triangle_stats_.submitted++;
+                if (context_size > 0) shader.setupContext(data0, data1, data2, context);
+                drawClipSpaceTriangle(transformed_vertices_[i0], transformed_vertices_[i1], transformed_vertices_[i2], shader, data0, data1, data2, context);
+            }
+            return;
+        }
         for (size_t i = 0; i < indices.size(); i += 3) {
             uint32_t i0 = indices[i];
             uint32_t i1 = indices[i + 1];
@@ -73,19 +279,208 @@ public:
             void* data2 = sampler.getValue(i2);
             drawTriangle(v0, v1, v2, shader, data0, data1, data2);
         }
-        downSample();
+    }
+
+    // draw a screen-space pass that is evaluated once per output pixel inside [min, max]
+    // shader(x, y) returns the color of output pixel (x, y), with coverage carried in alpha;
+    // the color is depth tested at 'z' (NDC) and blended into every sample of that pixel
+    template<typename PixelShader>
+    inline void drawPixels(int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, float z, PixelShader&& shader) {
+        Rect rect = Rect{min_x, min_y, max_x, max_y}.intersect(getDrawRect());
+        if (rect.empty()) return;
+        dirty_rect_ = dirty_rect_.unite(rect);
+        float depth = (z + 1.0f) * 0.5f;
+        if (depth < 0.0f || depth > 1.0f) return;
+        if (target_depthbuffer16_ptr_ != nullptr) {
+            fillPixels<uint16_t>(rect, depth, shader);
+        } else {
+            fillPixels<float>(rect, depth, shader);
+        }
+    }
+
+    // draw a screen-space pass straight into the output framebuffer, bypassing the sample
+    // targets and the depth buffer; for passes that antialias themselves, so the samples of
+    // a pixel would all get the same color. Samples drawn around it are blended over the
+    // result by resolveOver()
+    template<typename PixelShader>
+    inline void drawOutputPixels(int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, PixelShader&& shader) {
+        Rect rect = Rect{min_x, min_y, max_x, max_y}.intersect(getDrawRect());
+        if (rect.empty()) return;
+        dirty_rect_ = dirty_rect_.unite(rect);
+        bool replace = draw_state_.blend_mode == BlendMode::REPLACE;
+        for (int32_t y = rect.min_y; y <= rect.max_y; y++) {
+            RGBColor* output = (*framebuffer_)[y];
+            for (int32_t x = rect.min_x; x <= rect.max_x; x++) {
+                RGBColor srcColor = shader(x, y);
+                if (srcColor.a == 0) continue;
+                output[x] = replace ? srcColor : alphaBlend(srcColor, output[x]);
+            }
+        }
+    }
+
+    // clear the output pixels inside 'rect', leaving the samples alone
+    inline void clearOutput(const RGBColor& color, const Rect& rect) {
+        Rect clipped = rect.intersect(getViewportRect());
+        for (int32_t y = clipped.min_y; y <= clipped.max_y; y++) {
+            std::fill((*framebuffer_)[y] + clipped.min_x, (*framebuffer_)[y] + clipped.max_x + 1, color);
+        }
+    }
+
+    // resolve the render target into the output framebuffer
+    // must be called once after all draws of a frame (no-op without antialiasing)
+    inline void resolve() {
+        downSample<false>(getViewportRect());
+    }
+
+    // resolve only the output pixels inside 'rect'
+    inline void resolve(const Rect& rect) {
+        Rect clipped = rect.intersect(getViewportRect());
+        if (clipped.empty()) return;
+        downSample<false>(clipped);
+    }
+
+    // resolve samples that start fully transparent as a layer with premultiplied alpha over
+    // the output pixels inside 'rect' (result = samples + output * (1 - sample alpha)), which
+    // keeps what drawOutputPixels() drew under the samples; without antialiasing the samples
+    // are the output, so there is nothing to do
+    inline void resolveOver(const Rect& rect) {
+        Rect clipped = rect.intersect(getViewportRect());
+        if (clipped.empty()) return;
+        downSample<true>(clipped);
+    }
+
+    // blend a layer with premultiplied alpha over the output pixels inside 'rect'
+    // (result = layer + framebuffer * (1 - layer alpha)); used after resolve() to
+    // composite static content that is rendered once and cached
+    inline void compositeLayer(const GraphicsBuffer<RGBColor>& layer, const Rect& rect) {
+        if (layer.getWidth() != framebuffer_->getWidth() || layer.getHeight() != framebuffer_->getHeight()) {
+            throw std::runtime_error("layer and framebuffer have different sizes");
+        }
+        Rect clipped = rect.intersect(getViewportRect());
+        for (int32_t y = clipped.min_y; y <= clipped.max_y; y++) {
+            const RGBColor* src = layer[y];
+            RGBColor* dst = (*framebuffer_)[y];
+            for (int32_t x = clipped.min_x; x <= clipped.max_x; x++) {
+                compositePixel(src[x], dst[x]);
+            }
+        }
     }
 
 private:
-    inline RGBColor alphaBlend(const RGBColor& src, const RGBColor& dst) {
-        float src_alpha = src.a / 255.0f;
-        float inv_alpha = 1.0f - src_alpha;
+    // color samples of one pixel row, addressed by sample index, in either layout
+    struct InterleavedRow {
+        RGBColor* samples;
+        RGBColor load(uint32_t i) const { return samples[i]; }
+        void store(uint32_t i, const RGBColor& color) const { samples[i] = color; }
+    };
+    struct PlanarRow {
+        uint8_t* r;
+        uint8_t* g;
+        uint8_t* b;
+        uint8_t* a;
+        RGBColor load(uint32_t i) const { return RGBColor{r[i], g[i], b[i], a[i]}; }
+        void store(uint32_t i, const RGBColor& color) const {
+            r[i] = color.r;
+            g[i] = color.g;
+            b[i] = color.b;
+            a[i] = color.a;
+        }
+    };
+    struct TiledRow {
+        RGBColor* tiles;         // first tile of the tile row
+        const uint32_t* offsets; // offset of the first sample of each pixel of the row
+        uint32_t sample_shift;   // log2(samples per pixel)
+        RGBColor& at(uint32_t i) const {
+            return tiles[offsets[i >> sample_shift] + (i & ((1u << sample_shift) - 1))];
+        }
+        RGBColor load(uint32_t i) const { return at(i); }
+        void store(uint32_t i, const RGBColor& color) const { at(i) = color; }
+    };
+
+    // pixels per tile side of TILED targets
+    static constexpr uint32_t tile_size = 8;
+
+    // spreads the 3 bits of a tile coordinate over the even bits of a Morton code
+    static constexpr uint32_t mortonSpread(uint32_t v) {
+        return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2);
+    }
+
+    template<typename Row>
+    inline Row getColorRow(int32_t y) const {
+        if constexpr (std::is_same_v<Row, PlanarRow>) {
+            // plane c occupies rows [c * height, (c + 1) * height) of the plane buffer
+            const uint32_t height = framebuffer_->getHeight();
+            GraphicsBuffer<uint8_t>& planes = *super_sample_planes_;
+            return PlanarRow{planes[y], planes[height + y], planes[2 * height + y], planes[3 * height + y]};
+        } else if constexpr (std::is_same_v<Row, TiledRow>) {
+            // every tile is one (pitch aligned) row of the tile buffer
+            GraphicsBuffer<RGBColor>& tiles = *super_sample_framebuffer_;
+            return TiledRow{tiles[(y / tile_size) * tile_columns_], tile_offsets_.data() + (y % tile_size) * framebuffer_->getWidth(), sample_shift_};
+        } else {
+            return InterleavedRow{(*target_framebuffer_ptr_)[y]};
+        }
+    }
+
+    // output pixels that draws may touch: the viewport, restricted by the scissor rectangle
+    inline Rect getDrawRect() const {
+        Rect rect = getViewportRect();
+        return draw_state_.scissor_test ? rect.intersect(draw_state_.scissor) : rect;
+    }
+
+    // fill the samples of the output pixels inside 'rect' of a sample target
+    // (or of the plane whose rows start at 'first_row')
+    template<typename T>
+    inline void clearRegion(GraphicsBuffer<T>& target, const T& value, const Rect& rect, uint32_t first_row = 0) {
+        Rect clipped = rect.intersect(getViewportRect());
+        if (clipped.empty()) return;
+        const uint32_t n_samples = sample_count_;
+        for (int32_t y = clipped.min_y; y <= clipped.max_y; y++) {
+            T* row = target[first_row + y];
+            std::fill(row + clipped.min_x * n_samples, row + (clipped.max_x + 1) * n_samples, value);
+        }
+    }
+
+    // x / 255 for x in [0, 255 * 255 + 127], exact (multiply-shift instead of a division)
+    static inline uint32_t div255(uint32_t x) {
+        return (x * 0x8081u) >> 23;
+    }
+
+    // premultiplied source-over: dst = src + dst * (1 - src alpha), rounded to nearest
+    static inline void compositePixel(const RGBColor& src, RGBColor& dst) {
+        uint32_t alpha = src.a;
+        if (alpha == 0) return;
+        if (alpha == 255) {
+            dst = src;
+            return;
+        }
+        uint32_t inv_alpha = 255 - alpha;
+        dst.r = static_cast<uint8_t>(src.r + div255(dst.r * inv_alpha + 127));
+        dst.g = static_cast<uint8_t>(src.g + div255(dst.g * inv_alpha + 127));
+        dst.b = static_cast<uint8_t>(src.b + div255(dst.b * inv_alpha + 127));
+        dst.a = static_cast<uint8_t>(alpha + div255(dst.a * inv_alpha + 127));
+    }
+
+    // output pixel of a resolve: the average itself, or the average composited over the pixel
+    template<bool Over>
+    static inline void storeResolved(const RGBColor& average, RGBColor& output) {
+        if constexpr (Over) {
+            compositePixel(average, output);
+        } else {
+            output = average;
+        }
+    }
+
+    // source-over blending, rounded to nearest: (a * s + (255 - a) * d + 127) / 255
+    static inline RGBColor alphaBlend(const RGBColor& src, const RGBColor& dst) {
+        if (src.a == 255) return src;
+        uint32_t alpha = src.a;
+        uint32_t inv_alpha = 255 - alpha;
 
         RGBColor result;
-        result.r = static_cast<uint8_t>(src.r * src_alpha + dst.r * inv_alpha);
-        result.g = static_cast<uint8_t>(src.g * src_alpha + dst.g * inv_alpha);
-        result.b = static_cast<uint8_t>(src.b * src_alpha + dst.b * inv_alpha);
-        result.a = static_cast<uint8_t>(std::min(255.0f, src.a + dst.a * inv_alpha));
+        result.r = static_cast<uint8_t>(div255(src.r * alpha + dst.r * inv_alpha + 127));
+        result.g = static_cast<uint8_t>(div255(src.g * alpha + dst.g * inv_alpha + 127));
+        result.b = static_cast<uint8_t>(div255(src.b * alpha + dst.b * inv_alpha + 127));
+        result.a = static_cast<uint8_t>(alpha + div255(dst.a * inv_alpha + 127));
         return result;
     }
 
@@ -95,49 +490,622 @@ private:
         Vertex v2_(v2);
         void* context = alloca(shader.getContextSize());
 
+        triangle_stats_.submitted++;
         bool drawable = shader.vertexShader(v0_, v1_, v2_, data0, data1, data2, context);
         if (!drawable) return;
+        drawClipSpaceTriangle(v0_, v1_, v2_, shader, data0, data1, data2, context);
+    }
 
-        viewportTransform(v0_);
-        viewportTransform(v1_);
-        viewportTransform(v2_);
+    // clipping, culling and rasterization of a triangle output by the vertex stage
+    inline void drawClipSpaceTriangle(Vertex v0_, Vertex v1_, Vertex v2_, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        // trivial reject: every vertex outside the same clip plane or viewport edge
+        const uint32_t code0 = clipCode(v0_);
+        const uint32_t code1 = clipCode(v1_);
+        const uint32_t code2 = clipCode(v2_);
+        if ((code0 & code1 & code2) != 0) {
+            triangle_stats_.rejected++;
+            return;
+        }
 
-        Triangle triangle{v0_.position, v1_.position, v2_.position, 1.0f / v0_.w, 1.0f / v1_.w, 1.0f / v2_.w};
+        // trivial accept: every vertex inside the guard band and the depth range,
+        // the screen edges are handled by the bounding box and the samples
+        const uint32_t planes = (code0 | code1 | code2) & CLIP_PLANES;
+        if (planes == 0) {
+            viewportTransform(v0_);
+            viewportTransform(v1_);
+            viewportTransform(v2_);
+            setupTriangle(v0_, v1_, v2_, shader, data0, data1, data2, context);
+            return;
+        }
+        triangle_stats_.clipped++;
+        drawClippedTriangle(v0_, v1_, v2_, planes, shader, data0, data1, data2, context);
+    }
 
-        int32_t bbox_min_x = std::min({static_cast<int32_t>(v0_.position.x), static_cast<int32_t>(v1_.position.x), static_cast<int32_t>(v2_.position.x)});
-        int32_t bbox_min_y = std::min({static_cast<int32_t>(v0_.position.y), static_cast<int32_t>(v1_.position.y), static_cast<int32_t>(v2_.position.y)});
-        int32_t bbox_max_x = std::max({static_cast<int32_t>(v0_.position.x), static_cast<int32_t>(v1_.position.x), static_cast<int32_t>(v2_.position.x)});
-        int32_t bbox_max_y = std::max({static_cast<int32_t>(v0_.position.y), static_cast<int32_t>(v1_.position.y), static_cast<int32_t>(v2_.position.y)});
-        bbox_min_x = std::max(0, bbox_min_x);
-        bbox_min_y = std::max(0, bbox_min_y);
-        bbox_max_x = std::min(static_cast<int32_t>(target_framebuffer_ptr_->getWidth() - 1), bbox_max_x);
-        bbox_max_y = std::min(static_cast<int32_t>(target_framebuffer_ptr_->getHeight() - 1), bbox_max_y);
+    // screen-space triangle setup: culling, bounding box, then the fill loops
+    inline void setupTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        // zero-area triangles cover no sample, so they are dropped before the bounding box
+        const Vector2 e0 = Vector2(v1.position - v0.position);
+        const Vector2 e1 = Vector2(v2.position - v0.position);
+        const float d01 = e0.dot(e1);
+        if (e0.dot(e0) * e1.dot(e1) - d01 * d01 < 1e-6f) {
+            triangle_stats_.degenerate++;
+            return;
+        }
+        // signed area, negative for front faces
+        if (draw_state_.cull_mode != CullMode::NONE) {
+            const float area = e0.x * e1.y - e0.y * e1.x;
+            if ((draw_state_.cull_mode == CullMode::BACK) == (area > 0.0f)) {
+                triangle_stats_.face_culled++;
+                return;
+            }
+        }
 
-        for (int32_t y = bbox_min_y; y <= bbox_max_y; y++) {
-            for (int32_t x = bbox_min_x; x <= bbox_max_x; x++) {
-                Barycentric barycentric = calculateBarycentric(triangle, {static_cast<float>(x), static_cast<float>(y)});
-                if (barycentric.l0 < 0 || barycentric.l1 < 0 || barycentric.l2 < 0) continue;
+        Triangle triangle{v0.position, v1.position, v2.position, 1.0f / v0.w, 1.0f / v1.w, 1.0f / v2.w};
 
-                float z = v0_.position.z * barycentric.l0 + v1_.position.z * barycentric.l1 + v2_.position.z * barycentric.l2;
-                if (z < 0.0f || z > 1.0f) continue;
-                if (z > target_depthbuffer_ptr_->getValue(x, y)) continue;
+        int32_t bbox_min_x = std::min({static_cast<int32_t>(v0.position.x), static_cast<int32_t>(v1.position.x), static_cast<int32_t>(v2.position.x)});
+        int32_t bbox_min_y = std::min({static_cast<int32_t>(v0.position.y), static_cast<int32_t>(v1.position.y), static_cast<int32_t>(v2.position.y)});
+        int32_t bbox_max_x = std::max({static_cast<int32_t>(v0.position.x), static_cast<int32_t>(v1.position.x), static_cast<int32_t>(v2.position.x)});
+        int32_t bbox_max_y = std::max({static_cast<int32_t>(v0.position.y), static_cast<int32_t>(v1.position.y), static_cast<int32_t>(v2.position.y)});
+        Rect bbox = Rect{bbox_min_x, bbox_min_y, bbox_max_x, bbox_max_y}.intersect(getDrawRect());
+        if (bbox.empty()) return;
+        dirty_rect_ = dirty_rect_.unite(bbox);
 
-                RGBColor srcColor = shader.fragmentShader(triangle, barycentric, data0, data1, data2, context);
-                if (srcColor.a == 0) continue;
-                RGBColor dstColor = target_framebuffer_ptr_->getValue(x, y);
-                RGBColor finalColor = alphaBlend(srcColor, dstColor);
-                target_framebuffer_ptr_->setValue(x, y, finalColor);
+        if (target_depthbuffer16_ptr_ != nullptr) {
+            rasterizeTriangle<uint16_t>(triangle, bbox, shader, data0, data1, data2, context);
+        } else {
+            rasterizeTriangle<float>(triangle, bbox, shader, data0, data1, data2, context);
+        }
+    }
+
+    // clip-space outcodes: bit p is set when the vertex is outside plane p
+    enum : uint32_t {
+        CLIP_W = 1u << 0,      // w below clip_min_w (at or behind the eye)
+        CLIP_NEAR = 1u << 1,   // z < -w
+        CLIP_FAR = 1u << 2,    // z > w
+        CLIP_LEFT = 1u << 3,   // x < -guard_band * w
+        CLIP_RIGHT = 1u << 4,  // x > guard_band * w
+        CLIP_BOTTOM = 1u << 5, // y < -guard_band * w
+        CLIP_TOP = 1u << 6,    // y > guard_band * w
+        CLIP_PLANES = (1u << 7) - 1,
+        // viewport edges: only used to reject, never clipped against
+        VIEW_LEFT = 1u << 7,
+        VIEW_RIGHT = 1u << 8,
+        VIEW_BOTTOM = 1u << 9,
+        VIEW_TOP = 1u << 10
+    };
+    static constexpr uint32_t clip_plane_count = 7;
+    static constexpr float clip_min_w = 1e-5f;
+
+    // signed distance of a clip-space vertex to clip plane 'plane' (negative outside)
+    inline float clipDistance(const Vertex& v, uint32_t plane) const {
+        switch (plane) {
+        case 0: return v.w - clip_min_w;
+        case 1: return v.position.z + v.w;
+        case 2: return v.w - v.position.z;
+        case 3: return v.position.x + guard_band_ * v.w;
+        case 4: return guard_band_ * v.w - v.position.x;
+        case 5: return v.position.y + guard_band_ * v.w;
+        default: return guard_band_ * v.w - v.position.y;
+        }
+    }
+
+    inline uint32_t clipCode(const Vertex& v) const {
+        uint32_t code = 0;
+        for (uint32_t plane = 0; plane < clip_plane_count; plane++) {
+            if (clipDistance(v, plane) < 0.0f) code |= 1u << plane;
+        }
+        const float x = v.position.x, y = v.position.y, w = v.w;
+        if (x < -w) code |= VIEW_LEFT;
+        if (x > w) code |= VIEW_RIGHT;
+        if (y < -w) code |= VIEW_BOTTOM;
+        if (y > w) code |= VIEW_TOP;
+        return code;
+    }
+
+    // a vertex of a clipped polygon, with its weights over the original triangle
+    struct ClipVertex {
+        Vertex position;
+        Barycentric weights;
+    };
+
+    // maps the screen-space barycentrics of a triangle cut from a clipped one back
+    // to perspective-correct weights over the original vertices, so the fragment
+    // shader keeps interpolating the original per-vertex data
+    struct ClipMapping {
+        Barycentric weights[3]; // original weights of each vertex, scaled by its 1/w
+        Triangle triangle;      // 1/w of 1: the mapped weights are already perspective-correct
+
+        Barycentric map(const Barycentric& b) const {
+            float l0 = weights[0].l0 * b.l0 + weights[1].l0 * b.l1 + weights[2].l0 * b.l2;
+            float l1 = weights[0].l1 * b.l0 + weights[1].l1 * b.l1 + weights[2].l1 * b.l2;
+            float l2 = weights[0].l2 * b.l0 + weights[1].l2 * b.l1 + weights[2].l2 * b.l2;
+            float inv_sum = 1.0f / (l0 + l1 + l2);
+            return {l0 * inv_sum, l1 * inv_sum, l2 * inv_sum};
+        }
+    };
 
-                if (srcColor.a == 255) {
-                    target_depthbuffer_ptr_->setValue(x, y, z);
+    // Sutherland-Hodgman clipping of the triangle against the crossed 'planes' in
+    // homogeneous space, then a fan of the remaining convex polygon
+    inline void drawClippedTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, uint32_t planes, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        // every plane adds at most one vertex
+        ClipVertex buffers[2][3 + clip_plane_count];
+        ClipVertex* polygon = buffers[0];
+        ClipVertex* clipped = buffers[1];
+        polygon[0] = {v0, {1.0f, 0.0f, 0.0f}};
+        polygon[1] = {v1, {0.0f, 1.0f, 0.0f}};
+        polygon[2] = {v2, {0.0f, 0.0f, 1.0f}};
+        uint32_t count = 3;
+
+        for (uint32_t plane = 0; plane < clip_plane_count; plane++) {
+            if ((planes & (1u << plane)) == 0) continue;
+            uint32_t clipped_count = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                const ClipVertex& a = polygon[i];
+                const ClipVertex& b = polygon[i + 1 == count ? 0 : i + 1];
+                float da = clipDistance(a.position, plane);
+                float db = clipDistance(b.position, plane);
+                if (da >= 0.0f) clipped[clipped_count++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f)) {
+                    float t = da / (da - db);
+                    clipped[clipped_count++] = {
+                        a.position + (b.position - a.position) * t,
+                        {a.weights.l0 + (b.weights.l0 - a.weights.l0) * t, a.weights.l1 + (b.weights.l1 - a.weights.l1) * t,
+                         a.weights.l2 + (b.weights.l2 - a.weights.l2) * t}
+                    };
                 }
             }
+            std::swap(polygon, clipped);
+            count = clipped_count;
+            if (count < 3) return;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            viewportTransform(polygon[i].position);
         }
+        for (uint32_t i = 1; i + 1 < count; i++) {
+            const ClipVertex& c0 = polygon[0];
+            const ClipVertex& c1 = polygon[i];
+            const ClipVertex& c2 = polygon[i + 1];
+            const float w0 = 1.0f / c0.position.w, w1 = 1.0f / c1.position.w, w2 = 1.0f / c2.position.w;
+            ClipMapping mapping{
+                {{c0.weights.l0 * w0, c0.weights.l1 * w0, c0.weights.l2 * w0},
+                 {c1.weights.l0 * w1, c1.weights.l1 * w1, c1.weights.l2 * w1},
+                 {c2.weights.l0 * w2, c2.weights.l1 * w2, c2.weights.l2 * w2}},
+                {c0.position.position, c1.position.position, c2.position.position, 1.0f, 1.0f, 1.0f}
+            };
+            clip_mapping_ = &mapping;
+            setupTriangle(c0.position, c1.position, c2.position, shader, data0, data1, data2, context);
+        }
+        clip_mapping_ = nullptr;
+    }
+
+    // fragment shader call; fragments of a clipped triangle are shaded over the original vertices
+    inline RGBColor shadeFragment(Shader& shader, const Triangle& triangle, const Barycentric& barycentric, void* data0, void* data1, void* data2, void* context) const {
+        if (clip_mapping_ == nullptr) {
+            return shader.fragmentShader(triangle, barycentric, data0, data1, data2, context);
+        }
+        return shader.fragmentShader(clip_mapping_->triangle, clip_mapping_->map(barycentric), data0, data1, data2, context);
+    }
+
+    // dispatch on the color sample layout and the antialiasing method
+    template<typename Depth>
+    inline void rasterizeTriangle(const Triangle& triangle, const Rect& bbox, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        switch (target_layout_) {
+        case SampleLayout::PLANAR:
+            rasterizeTriangle<PlanarRow, Depth>(triangle, bbox, shader, data0, data1, data2, context);
+            break;
+        case SampleLayout::TILED:
+            rasterizeTriangle<TiledRow, Depth>(triangle, bbox, shader, data0, data1, data2, context);
+            break;
+        default:
+            rasterizeTriangle<InterleavedRow, Depth>(triangle, bbox, shader, data0, data1, data2, context);
+            break;
+        }
+    }
+    template<typename Row, typename Depth>
+    inline void rasterizeTriangle(const Triangle& triangle, const Rect& bbox, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        if (isMultisampled()) {
+            fillTriangleMultisampled<Row, Depth>(triangle, bbox, shader, data0, data1, data2, context);
+        } else {
+            fillTriangle<Row, Depth>(triangle, bbox, shader, data0, data1, data2, context);
+        }
+    }
+
+    // pixel pass dispatch of drawPixels
+    template<typename Depth, typename PixelShader>
+    inline void fillPixels(const Rect& rect, float depth, PixelShader& shader) {
+        switch (target_layout_) {
+        case SampleLayout::PLANAR:
+            fillPixels<PlanarRow, Depth>(rect, depth, shader);
+            break;
+        case SampleLayout::TILED:
+            fillPixels<TiledRow, Depth>(rect, depth, shader);
+            break;
+        default:
+            fillPixels<InterleavedRow, Depth>(rect, depth, shader);
+            break;
+        }
+    }
+
+    // pixel pass of drawPixels over the clipped rectangle
+    template<typename Row, typename Depth, typename PixelShader>
+    inline void fillPixels(const Rect& rect, float depth, PixelShader& shader) {
+        const uint32_t n_samples = sample_count_;
+        GraphicsBuffer<Depth>* depth_test_ptr = draw_state_.depth_test ? getDepthTarget<Depth>() : nullptr;
+        GraphicsBuffer<Depth>* depth_write_ptr = draw_state_.depth_write ? getDepthTarget<Depth>() : nullptr;
+        bool replace = draw_state_.blend_mode == BlendMode::REPLACE;
+        const Depth encoded_depth = encodeDepth<Depth>(depth);
+        const DepthTileTests tile_tests = prepareDepthTiles<Depth>(rect, depth, depth);
+
+        for (int32_t y = rect.min_y; y <= rect.max_y; y++) {
+            const Row color_row = getColorRow<Row>(y);
+            const Depth* depth_test_row = depth_test_ptr ? (*depth_test_ptr)[y] : nullptr;
+            Depth* depth_write_row = depth_write_ptr ? (*depth_write_ptr)[y] : nullptr;
+            // spans of one depth tile (or the whole row without depth test)
+            for (int32_t span_min = rect.min_x, span_max; span_min <= rect.max_x; span_min = span_max + 1) {
+                const Depth* test_row = depth_test_row;
+                span_max = tile_tests ? std::min(rect.max_x, span_min | static_cast<int32_t>(tile_size - 1)) : rect.max_x;
+                if (tile_tests) {
+                    uint8_t test = tile_tests.at(span_min, y);
+                    if (test == TILE_REJECT) continue;
+                    if (test == TILE_ACCEPT) test_row = nullptr;
+                }
+                uint32_t first_sample = span_min * n_samples;
+                for (int32_t x = span_min; x <= span_max; x++, first_sample += n_samples) {
+                    RGBColor srcColor = shader(x, y);
+                    if (srcColor.a == 0) continue;
+                    for (uint32_t sx = first_sample; sx < first_sample + n_samples; sx++) {
+                        if (test_row && encoded_depth > test_row[sx]) continue;
+                        color_row.store(sx, replace ? srcColor : alphaBlend(srcColor, color_row.load(sx)));
+                        if (depth_write_row && srcColor.a == 255) {
+                            depth_write_row[sx] = encoded_depth;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // edge functions of a screen-space triangle, for the coverage test and the barycentric weights
+    // each edge is evaluated from its lower endpoint (in y, then x) whichever way a triangle
+    // walks it, so the triangles on both sides of a shared edge get exactly opposite values.
+    // A sample exactly on an edge belongs to the triangle for which it is a top or left edge
+    // (top-left fill rule, the float form of biasing the other edges by one unit), so every
+    // sample along a shared edge is covered, and blended, exactly once
+    struct TriangleEdges {
+        struct Edge {
+            float x, y, dx, dy, sign;
+            inline float at(const Vector2& p) const { return sign * (dx * (p.y - y) - dy * (p.x - x)); }
+        };
+
+        explicit TriangleEdges(const Triangle& triangle)
+            : edges{edge(triangle.v1, triangle.v2), edge(triangle.v2, triangle.v0), edge(triangle.v0, triangle.v1)},
+              inv_area(1.0f / edges[0].at(Vector2(triangle.v0))) {
+            for (int i = 0; i < 3; i++) {
+                // gradient of the weight, pointing into the triangle (screen y points down):
+                // the interior lies right of a left edge, and below a horizontal top edge
+                const float gx = -edges[i].sign * edges[i].dy * inv_area;
+                const float gy = edges[i].sign * edges[i].dx * inv_area;
+                top_left[i] = gx > 0.0f || (gx == 0.0f && gy > 0.0f);
+            }
+        }
+
+        // barycentric weights of 'p', negative outside the triangle
+        inline Barycentric at(const Vector2& p) const {
+            return {edges[0].at(p) * inv_area, edges[1].at(p) * inv_area, edges[2].at(p) * inv_area};
+        }
+
+        // whether the weights of a sample place it inside the triangle under the fill rule
+        inline bool covers(const Barycentric& barycentric) const {
+            return inside(barycentric.l0, top_left[0]) && inside(barycentric.l1, top_left[1]) && inside(barycentric.l2, top_left[2]);
+        }
+
+        static inline bool inside(float weight, bool top_left) { return weight > 0.0f || (weight == 0.0f && top_left); }
+
+        static inline Edge edge(const Vector3& a, const Vector3& b) {
+            const bool flip = b.y < a.y || (b.y == a.y && b.x < a.x);
+            const Vector3& from = flip ? b : a;
+            const Vector3& to = flip ? a : b;
+            return {from.x, from.y, to.x - from.x, to.y - from.y, flip ? -1.0f : 1.0f};
+        }
+
+        Edge edges[3];
+        float inv_area;
+        bool top_left[3];
+    };
+
+    // SSAA path of drawTriangle: coverage, depth and shading per sample
+    template<typename Row, typename Depth>
+    inline void fillTriangle(const Triangle& triangle, const Rect& bbox, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        GraphicsBuffer<Depth>* depth_test_ptr = draw_state_.depth_test ? getDepthTarget<Depth>() : nullptr;
+        GraphicsBuffer<Depth>* depth_write_ptr = draw_state_.depth_write ? getDepthTarget<Depth>() : nullptr;
+        bool replace = draw_state_.blend_mode == BlendMode::REPLACE;
+
+        const uint32_t n_samples = sample_count_;
+        const Vector2* sample_offsets = sample_offsets_;
+        const TriangleEdges edges(triangle);
+        const DepthTileTests tile_tests = prepareDepthTiles<Depth>(bbox, std::min({triangle.v0.z, triangle.v1.z, triangle.v2.z}),
+                                                                   std::max({triangle.v0.z, triangle.v1.z, triangle.v2.z}));
+
+        for (int32_t y = bbox.min_y; y <= bbox.max_y; y++) {
+            const Row color_row = getColorRow<Row>(y);
+            const Depth* depth_test_row = depth_test_ptr ? (*depth_test_ptr)[y] : nullptr;
+            Depth* depth_write_row = depth_write_ptr ? (*depth_write_ptr)[y] : nullptr;
+            // spans of one depth tile (or the whole row without depth test)
+            for (int32_t span_min = bbox.min_x, span_max; span_min <= bbox.max_x; span_min = span_max + 1) {
+                const Depth* test_row = depth_test_row;
+                span_max = tile_tests ? std::min(bbox.max_x, span_min | static_cast<int32_t>(tile_size - 1)) : bbox.max_x;
+                if (tile_tests) {
+                    uint8_t test = tile_tests.at(span_min, y);
+                    if (test == TILE_REJECT) continue;
+                    if (test == TILE_ACCEPT) test_row = nullptr;
+                }
+                // samples of a pixel are stored next to each other
+                uint32_t first_sample = span_min * n_samples;
+                for (int32_t x = span_min; x <= span_max; x++, first_sample += n_samples) {
+                    for (uint32_t s = 0; s < n_samples; s++) {
+                        Vector2 p{x + sample_offsets[s].x, y + sample_offsets[s].y};
+                        Barycentric barycentric = edges.at(p);
+                        if (!edges.covers(barycentric)) continue;
+
+                        uint32_t sx = first_sample + s;
+                        float z = triangle.v0.z * barycentric.l0 + triangle.v1.z * barycentric.l1 + triangle.v2.z * barycentric.l2;
+                        if (z < 0.0f || z > 1.0f) continue;
+                        const Depth encoded_z = encodeDepth<Depth>(z);
+                        if (test_row && encoded_z > test_row[sx]) continue;
+
+                        RGBColor srcColor = shadeFragment(shader, triangle, barycentric, data0, data1, data2, context);
+                        if (srcColor.a == 0) continue;
+                        color_row.store(sx, replace ? srcColor : alphaBlend(srcColor, color_row.load(sx)));
+
+                        if (depth_write_row && srcColor.a == 255) {
+                            depth_write_row[sx] = encoded_z;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // MSAA path of drawTriangle: coverage and depth are resolved per sample, then the
+    // fragment shader runs once at the first covered sample and its color is written
+    // to every covered sample of the pixel
+    template<typename Row, typename Depth>
+    inline void fillTriangleMultisampled(const Triangle& triangle, const Rect& bbox, Shader& shader, void* data0, void* data1, void* data2, void* context) {
+        GraphicsBuffer<Depth>* depth_test_ptr = draw_state_.depth_test ? getDepthTarget<Depth>() : nullptr;
+        GraphicsBuffer<Depth>* depth_write_ptr = draw_state_.depth_write ? getDepthTarget<Depth>() : nullptr;
+        bool replace = draw_state_.blend_mode == BlendMode::REPLACE;
+
+        const uint32_t n_samples = sample_count_;
+        const Vector2* sample_offsets = sample_offsets_;
+        const TriangleEdges edges(triangle);
+        const DepthTileTests tile_tests = prepareDepthTiles<Depth>(bbox, std::min({triangle.v0.z, triangle.v1.z, triangle.v2.z}),
+                                                                   std::max({triangle.v0.z, triangle.v1.z, triangle.v2.z}));
+        Depth sample_z[16];
+
+        for (int32_t y = bbox.min_y; y <= bbox.max_y; y++) {
+            const Row color_row = getColorRow<Row>(y);
+            const Depth* depth_test_row = depth_test_ptr ? (*depth_test_ptr)[y] : nullptr;
+            Depth* depth_write_row = depth_write_ptr ? (*depth_write_ptr)[y] : nullptr;
+            // spans of one depth tile (or the whole row without depth test)
+            for (int32_t span_min = bbox.min_x, span_max; span_min <= bbox.max_x; span_min = span_max + 1) {
+                const Depth* test_row = depth_test_row;
+                span_max = tile_tests ? std::min(bbox.max_x, span_min | static_cast<int32_t>(tile_size - 1)) : bbox.max_x;
+                if (tile_tests) {
+                    uint8_t test = tile_tests.at(span_min, y);
+                    if (test == TILE_REJECT) continue;
+                    if (test == TILE_ACCEPT) test_row = nullptr;
+                }
+                uint32_t first_sample = span_min * n_samples;
+                for (int32_t x = span_min; x <= span_max; x++, first_sample += n_samples) {
+                    uint32_t coverage = 0;
+                    Barycentric shading_point{};
+                    for (uint32_t s = 0; s < n_samples; s++) {
+                        Vector2 p{x + sample_offsets[s].x, y + sample_offsets[s].y};
+                        Barycentric barycentric = edges.at(p);
+                        if (!edges.covers(barycentric)) continue;
+
+                        float z = triangle.v0.z * barycentric.l0 + triangle.v1.z * barycentric.l1 + triangle.v2.z * barycentric.l2;
+                        if (z < 0.0f || z > 1.0f) continue;
+                        const Depth encoded_z = encodeDepth<Depth>(z);
+                        if (test_row && encoded_z > test_row[first_sample + s]) continue;
+
+                        if (coverage == 0) shading_point = barycentric;
+                        coverage |= 1u << s;
+                        sample_z[s] = encoded_z;
+                    }
+                    if (coverage == 0) continue;
+
+                    RGBColor srcColor = shadeFragment(shader, triangle, shading_point, data0, data1, data2, context);
+                    if (srcColor.a == 0) continue;
+                    for (uint32_t s = 0; s < n_samples; s++) {
+                        if ((coverage & (1u << s)) == 0) continue;
+                        uint32_t sx = first_sample + s;
+                        color_row.store(sx, replace ? srcColor : alphaBlend(srcColor, color_row.load(sx)));
+
+                        if (depth_write_row && srcColor.a == 255) {
+                            depth_write_row[sx] = sample_z[s];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // depth target in the current depth sample format
+    template<typename Depth>
+    inline GraphicsBuffer<Depth>* getDepthTarget() const {
+        if constexpr (std::is_same_v<Depth, uint16_t>) {
+            return target_depthbuffer16_ptr_;
+        } else {
+            return target_depthbuffer_ptr_;
+        }
+    }
+
+    // depth in [0, 1] as stored in a depth target
+    template<typename Depth>
+    static inline Depth encodeDepth(float z) {
+        if constexpr (std::is_same_v<Depth, uint16_t>) {
+            return static_cast<uint16_t>(z * 65535.0f + 0.5f);
+        } else {
+            return z;
+        }
+    }
+
+    // the stored value of depth z in the current format, as a float
+    inline float storedDepth(float z) const {
+        return target_depthbuffer16_ptr_ != nullptr ? static_cast<float>(encodeDepth<uint16_t>(z)) : z;
+    }
+
+    // Hierarchical depth: conservative bounds of the stored depth values of every
+    // tile_size x tile_size output pixel tile. Bounds only widen when samples are
+    // written; a stale tile is tightened again from its samples when its bounds
+    // fail to decide a depth test. Tiles whose exact bounds keep failing too
+    // (overlapping geometry at similar depths) are re-read exponentially less often.
+    struct DepthTile {
+        float min;
+        float max;
+        bool stale;
+        uint8_t backoff = 0; // draws to skip between re-reads after an undecided one
+        uint8_t skip = 0;    // remaining draws to skip
+    };
+
+    enum : uint8_t {
+        TILE_TEST,   // test every sample
+        TILE_ACCEPT, // every sample of the tile passes the depth test
+        TILE_REJECT  // every sample of the tile fails the depth test
+    };
+
+    // depth test outcome of every tile under a draw (null when the test is disabled)
+    struct DepthTileTests {
+        const uint8_t* tests;
+        int32_t first_column;
+        int32_t first_row;
+        int32_t columns;
+        explicit operator bool() const { return tests != nullptr; }
+        uint8_t at(int32_t x, int32_t y) const {
+            return tests[(y / static_cast<int32_t>(tile_size) - first_row) * columns + x / static_cast<int32_t>(tile_size) - first_column];
+        }
+    };
+
+    // bounds unknown: never decide a test before the samples are read
+    inline void resetDepthTiles() {
+        if (target_depthbuffer_ptr_ == nullptr && target_depthbuffer16_ptr_ == nullptr) {
+            depth_tiles_.clear();
+            return;
+        }
+        const uint32_t rows = (framebuffer_->getHeight() + tile_size - 1) / tile_size;
+        depth_tiles_.assign(static_cast<size_t>(tile_columns_) * rows,
+                            DepthTile{-std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), true});
+    }
+
+    // widen the bounds of the tiles overlapping 'rect' by [min, max], or set them
+    // for the tiles it covers entirely when their samples were all overwritten
+    inline void updateDepthTiles(const Rect& rect, float min, float max, bool overwritten) {
+        if (rect.empty() || depth_tiles_.empty()) return;
+        const int32_t size = static_cast<int32_t>(tile_size);
+        const Rect viewport = getViewportRect();
+        for (int32_t tile_y = rect.min_y / size; tile_y <= rect.max_y / size; tile_y++) {
+            for (int32_t tile_x = rect.min_x / size; tile_x <= rect.max_x / size; tile_x++) {
+                DepthTile& tile = depth_tiles_[tile_y * tile_columns_ + tile_x];
+                Rect bounds = Rect{tile_x * size, tile_y * size, tile_x * size + size - 1, tile_y * size + size - 1}.intersect(viewport);
+                bool covered = rect.min_x <= bounds.min_x && rect.min_y <= bounds.min_y && rect.max_x >= bounds.max_x && rect.max_y >= bounds.max_y;
+                if (overwritten && covered) {
+                    tile = DepthTile{min, max, false};
+                    continue;
+                }
+                tile.min = std::min(tile.min, min);
+                tile.max = std::max(tile.max, max);
+                tile.stale = true;
+            }
+        }
+    }
+
+    // exact bounds of a tile from its samples
+    template<typename Depth>
+    inline void refreshDepthTile(int32_t tile_x, int32_t tile_y, DepthTile& tile) const {
+        const GraphicsBuffer<Depth>& target = *getDepthTarget<Depth>();
+        const uint32_t first_sample = tile_x * tile_size * sample_count_;
+        const uint32_t last_sample = std::min<uint32_t>((tile_x + 1) * tile_size, framebuffer_->getWidth()) * sample_count_;
+        const uint32_t last_row = std::min<uint32_t>((tile_y + 1) * tile_size, framebuffer_->getHeight());
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        for (uint32_t y = tile_y * tile_size; y < last_row; y++) {
+            const Depth* row = target[y];
+            for (uint32_t i = first_sample; i < last_sample; i++) {
+                min = std::min(min, static_cast<float>(row[i]));
+                max = std::max(max, static_cast<float>(row[i]));
+            }
+        }
+        tile.min = min;
+        tile.max = max;
+        tile.stale = false;
+    }
+
+    // Decides the depth test of the tiles under 'rect' for a draw with depths in
+    // [z_min, z_max], then widens their bounds by the depths it may write
+    template<typename Depth>
+    inline DepthTileTests prepareDepthTiles(const Rect& rect, float z_min, float z_max) {
+        if (getDepthTarget<Depth>() == nullptr || depth_tiles_.empty()) return DepthTileTests{nullptr, 0, 0, 0};
+        // interpolated depths may round slightly outside the range of the vertices
+        constexpr float epsilon = 1e-5f;
+        const float low = static_cast<float>(encodeDepth<Depth>(std::clamp(z_min - epsilon, 0.0f, 1.0f)));
+        const float high = static_cast<float>(encodeDepth<Depth>(std::clamp(z_max + epsilon, 0.0f, 1.0f)));
+        const int32_t size = static_cast<int32_t>(tile_size);
+        DepthTileTests tests{nullptr, rect.min_x / size, rect.min_y / size, rect.max_x / size - rect.min_x / size + 1};
+        const int32_t rows = rect.max_y / size - tests.first_row + 1;
+
+        if (draw_state_.depth_test) {
+            tile_tests_.resize(static_cast<size_t>(tests.columns) * rows);
+            for (int32_t row = 0; row < rows; row++) {
+                for (int32_t column = 0; column < tests.columns; column++) {
+                    const int32_t tile_x = tests.first_column + column;
+                    const int32_t tile_y = tests.first_row + row;
+                    DepthTile& tile = depth_tiles_[tile_y * tile_columns_ + tile_x];
+                    uint8_t& test = tile_tests_[row * tests.columns + column];
+                    test = classifyDepthTile(tile, low, high);
+                    if (test == TILE_TEST && tile.stale) {
+                        if (tile.skip > 0) {
+                            tile.skip--;
+                        } else {
+                            refreshDepthTile<Depth>(tile_x, tile_y, tile);
+                            test = classifyDepthTile(tile, low, high);
+                            tile.backoff = test == TILE_TEST ? static_cast<uint8_t>(std::min(2 * tile.backoff + 1, 63)) : 0;
+                            tile.skip = tile.backoff;
+                        }
+                    }
+                }
+            }
+            tests.tests = tile_tests_.data();
+        }
+
+        // samples that pass the depth test are nearer than the stored ones, so the
+        // upper bound only grows without the test
+        if (draw_state_.depth_write) {
+            const float written_max = draw_state_.depth_test ? -std::numeric_limits<float>::infinity() : high;
+            for (int32_t row = 0; row < rows; row++) {
+                for (int32_t column = 0; column < tests.columns; column++) {
+                    if (tests.tests && tile_tests_[row * tests.columns + column] == TILE_REJECT) continue;
+                    DepthTile& tile = depth_tiles_[(tests.first_row + row) * tile_columns_ + tests.first_column + column];
+                    tile.min = std::min(tile.min, low);
+                    tile.max = std::max(tile.max, written_max);
+                    tile.stale = true;
+                }
+            }
+        }
+        return tests;
+    }
+
+    // samples fail the depth test when their depth is greater than the stored one
+    static inline uint8_t classifyDepthTile(const DepthTile& tile, float low, float high) {
+        if (low > tile.max) return TILE_REJECT;
+        if (high <= tile.min) return TILE_ACCEPT;
+        return TILE_TEST;
     }
 
     inline void viewportTransform(Vertex& v) const {
-        float width = static_cast<float>(target_framebuffer_ptr_->getWidth());
-        float height = static_cast<float>(target_framebuffer_ptr_->getHeight());
+        float width = static_cast<float>(framebuffer_->getWidth());
+        float height = static_cast<float>(framebuffer_->getHeight());
 
         // perspective division
         v.position.x /= v.w;
@@ -150,86 +1118,352 @@ private:
         v.position.z = (v.position.z + 1.0f) * 0.5f;
     }
 
+    // runs on every setBuffers(): the depth tiles are only reset when the depth target,
+    // or the tile grid, changes (new sample targets come zero-filled from the pool)
     inline void updateSuperSampleBuffers() {
-        auto update_buffer = [this](uint32_t ssaa) {
-            // check buffer already exists
-            bool need_update = super_sample_framebuffer_ == nullptr;
-            // check buffer size is correct
-            if (!need_update) { need_update = super_sample_framebuffer_->getWidth() != framebuffer_->getWidth() * ssaa || super_sample_framebuffer_->getHeight() != framebuffer_->getHeight() * ssaa; }
-            // update buffer
-            if (need_update) {
-                super_sample_framebuffer_ = std::make_shared<GraphicsBuffer<RGBColor>>(framebuffer_->getWidth() * ssaa, framebuffer_->getHeight() * ssaa);
-                super_sample_depthbuffer_ = std::make_shared<GraphicsBuffer<float>>(framebuffer_->getWidth() * ssaa, framebuffer_->getHeight() * ssaa);
-            }
-            target_framebuffer_ptr_ = super_sample_framebuffer_.get();
-            target_depthbuffer_ptr_ = super_sample_depthbuffer_.get();
-        };
-        switch (aa_mode_) {
-        case AA_MODE::SSAA_2X:
-            update_buffer(2);
-            break;
-        case AA_MODE::SSAA_4X:
-            update_buffer(4);
-            break;
-        case AA_MODE::SSAA_8X:
-            update_buffer(8);
-            break;
-        case AA_MODE::SSAA_16X:
-            update_buffer(16);
-            break;
-        case AA_MODE::NONE:
-        default:
+        const void* previous_depth_target = getDepthTargetData();
+        sample_count_ = getSampleCount();
+        sample_shift_ = 0;
+        while ((1u << sample_shift_) < sample_count_) sample_shift_++;
+        sample_offsets_ = getSamplePattern(sample_count_);
+        tile_columns_ = (framebuffer_->getWidth() + tile_size - 1) / tile_size;
+        if (aa_mode_ == AA_MODE::NONE) {
             target_framebuffer_ptr_ = framebuffer_.get();
             target_depthbuffer_ptr_ = depthbuffer_.get();
-            // release super sample buffers
+            target_depthbuffer16_ptr_ = nullptr;
+            target_layout_ = SampleLayout::INTERLEAVED;
+            // return the super sample buffers to the pool
             super_sample_framebuffer_ = nullptr;
+            super_sample_planes_ = nullptr;
             super_sample_depthbuffer_ = nullptr;
-            break;
+            super_sample_depthbuffer16_ = nullptr;
+            updateDepthTileGrid(previous_depth_target, false);
+            return;
+        }
+        target_layout_ = sample_layout_;
+        const bool planar = target_layout_ == SampleLayout::PLANAR;
+        // every row of the super sample buffers holds the samples of one pixel row,
+        // with the samples of each pixel stored contiguously
+        uint32_t width = framebuffer_->getWidth() * sample_count_;
+        uint32_t height = framebuffer_->getHeight();
+        // tiled color targets store one tile per row instead
+        uint32_t color_width = width, color_height = height;
+        if (target_layout_ == SampleLayout::TILED) {
+            color_width = tile_size * tile_size * sample_count_;
+            color_height = tile_columns_ * ((height + tile_size - 1) / tile_size);
+            updateTileOffsets(GraphicsBuffer<RGBColor>::alignedPitch(color_width));
+        }
+        // check buffer already exists in the requested layout
+        bool need_update = planar ? super_sample_planes_ == nullptr : super_sample_framebuffer_ == nullptr;
+        // check buffer size is correct (the four planes are stacked vertically)
+        if (!need_update && planar) { need_update = super_sample_planes_->getWidth() != width || super_sample_planes_->getHeight() != height * 4; }
+        if (!need_update && !planar) { need_update = super_sample_framebuffer_->getWidth() != color_width || super_sample_framebuffer_->getHeight() != color_height; }
+        // check depth buffer presence matches the output buffers
+        if (!need_update) { need_update = (super_sample_depthbuffer_ == nullptr && super_sample_depthbuffer16_ == nullptr) != (depthbuffer_ == nullptr); }
+        // check the depth sample format
+        if (!need_update && depthbuffer_) { need_update = (super_sample_depthbuffer16_ != nullptr) != (depth_format_ == DepthFormat::UNORM16); }
+        // update buffer: sample targets are recycled through the global pools, which
+        // hand them out zero-filled (transparent black, depth 0) until they are cleared
+        if (need_update) {
+            // give the old targets back first, so they can be reused by the next acquire
+            super_sample_framebuffer_ = nullptr;
+            super_sample_planes_ = nullptr;
+            super_sample_depthbuffer_ = nullptr;
+            super_sample_depthbuffer16_ = nullptr;
+            if (planar) {
+                super_sample_planes_ = GraphicsBufferPool<uint8_t>::global().acquire(width, height * 4);
+            } else {
+                super_sample_framebuffer_ = GraphicsBufferPool<RGBColor>::global().acquire(color_width, color_height);
+            }
+            if (depthbuffer_ && depth_format_ == DepthFormat::UNORM16) {
+                super_sample_depthbuffer16_ = GraphicsBufferPool<uint16_t>::global().acquire(width, height);
+            } else if (depthbuffer_) {
+                super_sample_depthbuffer_ = GraphicsBufferPool<float>::global().acquire(width, height);
+            }
+            dirty_rect_ = getViewportRect();
         }
+        // planar and tiled targets are addressed through getColorRow()
+        target_framebuffer_ptr_ = super_sample_framebuffer_.get();
+        target_depthbuffer_ptr_ = super_sample_depthbuffer_.get();
+        target_depthbuffer16_ptr_ = super_sample_depthbuffer16_.get();
+        updateDepthTileGrid(previous_depth_target, need_update);
     }
 
-    inline void downSample() {
-        if (aa_mode_ == AA_MODE::NONE) return;
-        auto down_sample = [this](uint32_t ssaa) {
-            uint32_t ssaa2f = ssaa * ssaa;
-            for (uint32_t y = 0; y < framebuffer_->getHeight(); y++) {
-                for (uint32_t x = 0; x < framebuffer_->getWidth(); x++) {
-                    Vector3i color;
-                    int alpha = 0;
-                    float min_depth = std::numeric_limits<float>::max();
-                    for (uint32_t j = 0; j < ssaa; j++) {
-                        for (uint32_t i = 0; i < ssaa; i++) {
-                            const RGBColor& c = super_sample_framebuffer_->getValue(x * ssaa + i, y * ssaa + j);
-                            color.x += c.r; color.y += c.g; color.z += c.b;
-                            alpha += c.a;
-                            float depth = super_sample_depthbuffer_->getValue(x * ssaa + i, y * ssaa + j);
-                            min_depth = std::min(min_depth, depth);
-                        }
-                    }
-                    color /= ssaa2f;
-                    alpha /= ssaa2f;
-                    framebuffer_->setValue(x, y, RGBColor{static_cast<uint8_t>(color.x), static_cast<uint8_t>(color.y), static_cast<uint8_t>(color.z), static_cast<uint8_t>(alpha)});
-                    depthbuffer_->setValue(x, y, min_depth);
-                }
+    // storage of the current depth target (null without one)
+    inline const void* getDepthTargetData() const {
+        if (target_depthbuffer16_ptr_ != nullptr) return target_depthbuffer16_ptr_->getData();
+        if (target_depthbuffer_ptr_ != nullptr) return target_depthbuffer_ptr_->getData();
+        return nullptr;
+    }
+
+    // reset the depth tiles unless they still describe the same depth target
+    inline void updateDepthTileGrid(const void* previous_depth_target, bool targets_replaced) {
+        size_t tiles = 0;
+        if (target_depthbuffer_ptr_ != nullptr || target_depthbuffer16_ptr_ != nullptr) {
+            tiles = static_cast<size_t>(tile_columns_) * ((framebuffer_->getHeight() + tile_size - 1) / tile_size);
+        }
+        if (targets_replaced || getDepthTargetData() != previous_depth_target || depth_tiles_.size() != tiles) { resetDepthTiles(); }
+    }
+
+    // sample positions relative to the pixel origin
+    // NONE samples the pixel center, like the antialiasing modes, so every mode
+    // places edges at the same position; the antialiasing patterns are the
+    // standard 2x/4x/8x/16x positions (in 1/16 pixel units around the pixel center)
+    static inline const Vector2* getSamplePattern(uint32_t n_samples) {
+        static const auto make_pattern = [](std::initializer_list<Vector2i> positions) {
+            std::vector<Vector2> pattern;
+            for (const Vector2i& p : positions) {
+                pattern.push_back({0.5f + p.x / 16.0f, 0.5f + p.y / 16.0f});
             }
+            return pattern;
         };
-        switch (aa_mode_) {
-        case AA_MODE::SSAA_2X:
-            down_sample(2);
+        static const Vector2 pattern_1x[] = {{0.5f, 0.5f}};
+        static const std::vector<Vector2> pattern_2x = make_pattern({{4, 4}, {-4, -4}});
+        static const std::vector<Vector2> pattern_4x = make_pattern({{-2, -6}, {6, -2}, {-6, 2}, {2, 6}});
+        static const std::vector<Vector2> pattern_8x = make_pattern({{1, -3}, {-1, 3}, {5, 1}, {-3, -5}, {-5, 5}, {-7, -1}, {3, 7}, {7, -7}});
+        static const std::vector<Vector2> pattern_16x = make_pattern({
+            {1, 1}, {-1, -3}, {-3, 2}, {4, -1}, {-5, -2}, {2, 5}, {5, 3}, {3, -5},
+            {-2, 6}, {0, -7}, {-4, -6}, {-6, 4}, {-8, 0}, {7, -4}, {6, 7}, {-7, -8}});
+        switch (n_samples) {
+        case 2: return pattern_2x.data();
+        case 4: return pattern_4x.data();
+        case 8: return pattern_8x.data();
+        case 16: return pattern_16x.data();
+        default: return pattern_1x;
+        }
+    }
+
+    // SSAA and MSAA targets share the same layout and are resolved alike
+    template<bool Over>
+    inline void downSample(const Rect& rect) {
+        switch (sample_count_) {
+        case 2:
+            downSample<2, Over>(rect);
             break;
-        case AA_MODE::SSAA_4X:
-            down_sample(4);
+        case 4:
+            downSample<4, Over>(rect);
             break;
-        case AA_MODE::SSAA_8X:
-            down_sample(8);
+        case 8:
+            downSample<8, Over>(rect);
             break;
-        case AA_MODE::SSAA_16X:
-            down_sample(16);
+        case 16:
+            downSample<16, Over>(rect);
+            break;
+        default:
+            break;
+        }
+    }
+
+    template<uint32_t N, bool Over>
+    inline void downSample(const Rect& rect) {
+        switch (target_layout_) {
+        case SampleLayout::PLANAR:
+            resolveColorPlanar<N, Over>(rect);
+            break;
+        case SampleLayout::TILED:
+            resolveColorTiled<N, Over>(rect);
             break;
-        case AA_MODE::NONE:
         default:
+            resolveColor<N, Over>(rect);
             break;
         }
+        // depth-less rendering has nothing more to resolve
+        if (super_sample_depthbuffer16_ != nullptr) {
+            resolveDepth16<N>(rect);
+        } else if (depthbuffer_ != nullptr) {
+            resolveDepth<N>(rect);
+        }
+    }
+
+    // Averages the N contiguous samples of every pixel, streaming each sample row once
+    template<uint32_t N, bool Over>
+    inline void resolveColor(const Rect& rect) {
+        for (int32_t y = rect.min_y; y <= rect.max_y; y++) {
+            const RGBColor* samples = (*super_sample_framebuffer_)[y] + rect.min_x * N;
+            RGBColor* output = (*framebuffer_)[y];
+            for (int32_t x = rect.min_x; x <= rect.max_x; x++, samples += N) {
+                storeResolved<Over>(averageSamples<N>(samples), output[x]);
+            }
+        }
+    }
+
+    // Tiled counterpart of resolveColor: every tile row is streamed linearly,
+    // pixel by pixel in Morton order, skipping the pixels outside 'rect'
+    template<uint32_t N, bool Over>
+    inline void resolveColorTiled(const Rect& rect) {
+        const GraphicsBuffer<RGBColor>& tiles = *super_sample_framebuffer_;
+        for (int32_t tile_y = rect.min_y / tile_size; tile_y <= rect.max_y / static_cast<int32_t>(tile_size); tile_y++) {
+            for (int32_t tile_x = rect.min_x / tile_size; tile_x <= rect.max_x / static_cast<int32_t>(tile_size); tile_x++) {
+                const RGBColor* samples = tiles[tile_y * tile_columns_ + tile_x];
+                const int32_t origin_x = tile_x * tile_size;
+                const int32_t origin_y = tile_y * tile_size;
+                const bool inside = origin_x >= rect.min_x && origin_y >= rect.min_y &&
+                                    origin_x + static_cast<int32_t>(tile_size) - 1 <= rect.max_x &&
+                                    origin_y + static_cast<int32_t>(tile_size) - 1 <= rect.max_y;
+                for (uint32_t code = 0; code < tile_size * tile_size; code++, samples += N) {
+                    const int32_t x = origin_x + static_cast<int32_t>(mortonCompact(code));
+                    const int32_t y = origin_y + static_cast<int32_t>(mortonCompact(code >> 1));
+                    if (!inside && (x < rect.min_x || x > rect.max_x || y < rect.min_y || y > rect.max_y)) continue;
+                    storeResolved<Over>(averageSamples<N>(samples), (*framebuffer_)[y][x]);
+                }
+            }
+        }
+    }
+
+    // sample offsets of every pixel from the first tile of its tile row, one table
+    // per pixel row inside a tile, so TiledRow accesses need no Morton arithmetic
+    inline void updateTileOffsets(size_t tile_stride) {
+        const uint32_t width = framebuffer_->getWidth();
+        if (tile_offsets_.size() == static_cast<size_t>(tile_size) * width && tile_offsets_stride_ == tile_stride && tile_offsets_shift_ == sample_shift_) return;
+        tile_offsets_stride_ = tile_stride;
+        tile_offsets_shift_ = sample_shift_;
+        tile_offsets_.resize(static_cast<size_t>(tile_size) * width);
+        for (uint32_t row = 0; row < tile_size; row++) {
+            const uint32_t row_code = mortonSpread(row) << 1;
+            for (uint32_t x = 0; x < width; x++) {
+                const uint32_t code = row_code | mortonSpread(x % tile_size);
+                tile_offsets_[row * width + x] = static_cast<uint32_t>((x / tile_size) * tile_stride + (code << sample_shift_));
+            }
+        }
+    }
+
+    // inverse of mortonSpread: the even bits of a Morton code
+    static constexpr uint32_t mortonCompact(uint32_t code) {
+        return (code & 1) | ((code >> 1) & 2) | ((code >> 2) & 4);
+    }
+
+    // Average of N contiguous RGBA samples. Channel sums are accumulated in
+    // 16-bit lanes and divided by a shift.
+    template<uint32_t N>
+    static inline RGBColor averageSamples(const RGBColor* samples) {
+        static_assert(N >= 2 && N <= 16 && (N & (N - 1)) == 0, "sample count must be a power of two in [2, 16]");
+        constexpr int shift = N == 2 ? 1 : N == 4 ? 2 : N == 8 ? 3 : 4; // log2(N)
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(samples);
+        // two partial RGBA sums in 16-bit lanes
+        __m128i sum;
+        if constexpr (N == 2) {
+            sum = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bytes)), zero);
+        } else {
+            sum = zero;
+            for (uint32_t i = 0; i < N * sizeof(RGBColor); i += 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+                sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpacklo_epi8(block, zero), _mm_unpackhi_epi8(block, zero)));
+            }
+        }
+        // horizontal sum of the two partial sums, then divide and pack to 8 bits
+        sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+        sum = _mm_srli_epi16(sum, shift);
+        uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+        return RGBColor{static_cast<uint8_t>(packed), static_cast<uint8_t>(packed >> 8), static_cast<uint8_t>(packed >> 16), static_cast<uint8_t>(packed >> 24)};
+#else
+        uint32_t r = 0, g = 0, b = 0, a = 0;
+        for (uint32_t i = 0; i < N; i++) {
+            r += samples[i].r; g += samples[i].g; b += samples[i].b; a += samples[i].a;
+        }
+        return RGBColor{static_cast<uint8_t>(r >> shift), static_cast<uint8_t>(g >> shift), static_cast<uint8_t>(b >> shift), static_cast<uint8_t>(a >> shift)};
+#endif
+    }
+
+    // sum of the N contiguous samples of one channel
+    template<uint32_t N>
+    static inline uint32_t sumChannel(const uint8_t* samples) {
+#if defined(__SSE2__)
+        // SAD against zero adds 8 bytes per 64-bit lane
+        const __m128i zero = _mm_setzero_si128();
+        if constexpr (N == 16) {
+            __m128i sums = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples)), zero);
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+        } else if constexpr (N == 8) {
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_sad_epu8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples)), zero)));
+        }
+#endif
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < N; i++) sum += samples[i];
+        return sum;
+    }
+
+    // Planar counterpart of resolveColor: every channel sum reads N contiguous
+    // bytes of its own plane, and the results are interleaved into the output
+    template<uint32_t N, bool Over>
+    inline void resolveColorPlanar(const Rect& rect) {
+        static_assert(N >= 2 && N <= 16 && (N & (N - 1)) == 0, "sample count must be a power of two in [2, 16]");
+        constexpr int shift = N == 2 ? 1 : N == 4 ? 2 : N == 8 ? 3 : 4; // log2(N)
+        for (int32_t y = rect.min_y; y <= rect.max_y; y++) {
+            const PlanarRow row = getColorRow<PlanarRow>(y);
+            const uint8_t* r = row.r + rect.min_x * N;
+            const uint8_t* g = row.g + rect.min_x * N;
+            const uint8_t* b = row.b + rect.min_x * N;
+            const uint8_t* a = row.a + rect.min_x * N;
+            RGBColor* output = (*framebuffer_)[y];
+            for (int32_t x = rect.min_x; x <= rect.max_x; x++, r += N, g += N, b += N, a += N) {
+                storeResolved<Over>(RGBColor{static_cast<uint8_t>(sumChannel<N>(r) >> shift), static_cast<uint8_t>(sumChannel<N>(g) >> shift),
+                                             static_cast<uint8_t>(sumChannel<N>(b) >> shift), static_cast<uint8_t>(sumChannel<N>(a) >> shift)},
+                                    output[x]);
+            }
+        }
+    }
+
+    // keeps the nearest depth of the N samples of every pixel
+    template<uint32_t N>
+    inline void resolveDepth(const Rect& rect) {
+        for (int32_t y = rect.min_y; y <= rect.max_y; y++) {
+            const float* samples = (*super_sample_depthbuffer_)[y] + rect.min_x * N;
+            float* output = (*depthbuffer_)[y];
+            for (int32_t x = rect.min_x; x <= rect.max_x; x++, samples += N) {
+#if defined(__SSE2__)
+                if constexpr (N >= 4) {
+                    __m128 nearest = _mm_loadu_ps(samples);
+                    for (uint32_t i = 4; i < N; i += 4) {
+                        nearest = _mm_min_ps(nearest, _mm_loadu_ps(samples + i));
+                    }
+                    nearest = _mm_min_ps(nearest, _mm_movehl_ps(nearest, nearest));
+                    nearest = _mm_min_ss(nearest, _mm_shuffle_ps(nearest, nearest, 1));
+                    output[x] = _mm_cvtss_f32(nearest);
+                    continue;
+                }
+#endif
+                float nearest = samples[0];
+                for (uint32_t i = 1; i < N; i++) {
+                    nearest = std::min(nearest, samples[i]);
+                }
+                output[x] = nearest;
+            }
+        }
+    }
+
+    // resolveDepth for 16-bit depth samples, converted back to float
+    template<uint32_t N>
+    inline void resolveDepth16(const Rect& rect) {
+        for (int32_t y = rect.min_y; y <= rect.max_y; y++) {
+            const uint16_t* samples = (*super_sample_depthbuffer16_)[y] + rect.min_x * N;
+            float* output = (*depthbuffer_)[y];
+            for (int32_t x = rect.min_x; x <= rect.max_x; x++, samples += N) {
+                uint32_t nearest;
+#if defined(__SSE2__)
+                if constexpr (N >= 8) {
+                    // unsigned minimum through the signed one, with the sign bit flipped
+                    const __m128i bias = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+                    __m128i m = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples)), bias);
+                    for (uint32_t i = 8; i < N; i += 8) {
+                        m = _mm_min_epi16(m, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i)), bias));
+                    }
+                    m = _mm_min_epi16(m, _mm_srli_si128(m, 8));
+                    m = _mm_min_epi16(m, _mm_srli_si128(m, 4));
+                    m = _mm_min_epi16(m, _mm_srli_si128(m, 2));
+                    nearest = (static_cast<uint32_t>(_mm_cvtsi128_si32(m)) & 0xffffu) ^ 0x8000u;
+                } else
+#endif
+                {
+                    nearest = samples[0];
+                    for (uint32_t i = 1; i < N; i++) {
+                        nearest = std::min<uint32_t>(nearest, samples[i]);
+                    }
+                }
+                output[x] = nearest * (1.0f / 65535.0f);
+            }
+        }
     }
 
 private:
@@ -238,12 +1472,38 @@ private:
     std::shared_ptr<GraphicsBuffer<float>> depthbuffer_;
     // for super sampling
     std::shared_ptr<GraphicsBuffer<RGBColor>> super_sample_framebuffer_;
+    std::shared_ptr<GraphicsBuffer<uint8_t>> super_sample_planes_;
     std::shared_ptr<GraphicsBuffer<float>> super_sample_depthbuffer_;
-    // target buffers
+    std::shared_ptr<GraphicsBuffer<uint16_t>> super_sample_depthbuffer16_;
+    // target buffers (one of the depth targets is set when depth is used)
     GraphicsBuffer<RGBColor>* target_framebuffer_ptr_;
     GraphicsBuffer<float>* target_depthbuffer_ptr_;
+    GraphicsBuffer<uint16_t>* target_depthbuffer16_ptr_;
+    SampleLayout target_layout_;
+    uint32_t tile_columns_;
+    // TILED targets: per-pixel sample offsets inside a tile row (see updateTileOffsets)
+    std::vector<uint32_t> tile_offsets_;
+    size_t tile_offsets_stride_ = 0;
+    uint32_t tile_offsets_shift_ = 0;
+    // samples per pixel and their positions
+    uint32_t sample_count_;
+    uint32_t sample_shift_;
+    const Vector2* sample_offsets_;
     // draw options
     AA_MODE aa_mode_;
+    SampleLayout sample_layout_;
+    DepthFormat depth_format_;
+    DrawState draw_state_;
+    float guard_band_;
+    // set while the triangles of a clipped one are rasterized
+    const ClipMapping* clip_mapping_;
+    TriangleStats triangle_stats_;
+    // output of the per-vertex stage of drawBuffer
+    DataBuffer<Vertex> transformed_vertices_;
+    // hierarchical depth bounds and the per-draw tile test scratch
+    std::vector<DepthTile> depth_tiles_;
+    std::vector<uint8_t> tile_tests_;
+    Rect dirty_rect_;
 };
 
 }
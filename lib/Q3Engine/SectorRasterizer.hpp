@@ -0,0 +1,157 @@
+#pragma once
+
+#include "RGBColor.hpp"
+#include "Math.hpp"
+#include "Rasterizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace q3 {
+
+/**
+ * @brief Draws a disc split into equal circular sectors with analytic anti-aliasing.
+ *
+ * Instead of approximating the sectors with triangle fans, every output pixel
+ * is classified from its polar coordinates (radius and angle around the disc
+ * center) in a single pass. Each edge (the nearest sector edge, and the rim
+ * taken as its tangent line) covers the area of the pixel square on its side
+ * of the line, so edges are smooth independently of the rasterizer's
+ * antialiasing mode. The coverage is exact for a pixel crossed by one straight
+ * edge, and approximate near the center, where several edges meet in a pixel.
+ * Rim coverage is written to alpha, for blending over the background.
+ *
+ * Since every pixel carries its own coverage, drawOutput() can skip the
+ * rasterizer's sample targets entirely; draw() goes through them instead, with
+ * depth testing, and writes the same color to every sample of a pixel.
+ *
+ * Sector k covers the counter-clockwise NDC angles
+ * [start_angle + k * step, start_angle + (k + 1) * step), step = 2 * pi / n.
+ */
+class SectorRasterizer {
+public:
+    SectorRasterizer() : center_(0.0f, 0.0f), radius_(1.0f), start_angle_(0.0f), z_(0.0f) {}
+
+    void setColors(std::vector<RGBColor> colors) { colors_ = std::move(colors); }
+    void setCenter(const Vector2& center) { center_ = center; }
+    // radius in NDC units of the smaller viewport axis
+    void setRadius(float radius) { radius_ = radius; }
+    void setStartAngle(float angle) { start_angle_ = angle; }
+    void setDepth(float z) { z_ = z; }
+
+    const std::vector<RGBColor>& getColors() const { return colors_; }
+
+    // depth tested, into every sample of the covered pixels
+    inline void draw(Rasterizer& rasterizer) {
+        render(rasterizer, [&](int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, auto& shader) {
+            rasterizer.drawPixels(min_x, min_y, max_x, max_y, z_, shader);
+        });
+    }
+
+    // straight into the output framebuffer (see Rasterizer::drawOutputPixels)
+    inline void drawOutput(Rasterizer& rasterizer) {
+        render(rasterizer, [&](int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, auto& shader) {
+            rasterizer.drawOutputPixels(min_x, min_y, max_x, max_y, shader);
+        });
+    }
+
+private:
+    // builds the pixel shader of the disc and passes it to draw_pixels with its bounds
+    template<typename DrawPixels>
+    inline void render(Rasterizer& rasterizer, DrawPixels&& draw_pixels) {
+        if (colors_.empty()) return;
+        const auto& framebuffer = *rasterizer.getFramebuffer();
+        float width = static_cast<float>(framebuffer.getWidth());
+        float height = static_cast<float>(framebuffer.getHeight());
+
+        // disc in pixel units
+        float scale = std::min(width, height) * 0.5f;
+        float cx = (center_.x + 1.0f) * width * 0.5f;
+        float cy = (1.0f - center_.y) * height * 0.5f;
+        float radius = radius_ * scale;
+
+        const size_t n = colors_.size();
+        const float step = 2.0f * static_cast<float>(M_PI) / n;
+        const float half_pi = static_cast<float>(M_PI) * 0.5f;
+        const float fn = static_cast<float>(n);
+
+        // |normal| of every sector edge (edge k starts sector k)
+        edge_normals_.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            float angle = start_angle_ + k * step;
+            edge_normals_[k] = {std::abs(std::sin(angle)), std::abs(std::cos(angle))};
+        }
+
+        auto shader = [&](int32_t x, int32_t y) -> RGBColor {
+            float dx = x + 0.5f - cx;
+            float dy = cy - (y + 0.5f); // y axis points up in NDC
+            float r = std::sqrt(dx * dx + dy * dy);
+
+            // coverage of the rim, along the radial direction
+            float rim_coverage = r > 0.0f ? coverage(radius - r, std::abs(dx) / r, std::abs(dy) / r) : 1.0f;
+            if (rim_coverage <= 0.0f) return RGBColor{0, 0, 0, 0};
+
+            RGBColor color = colors_[0];
+            if (n > 1) {
+                // sector index and position inside the sector
+                float t = (std::atan2(dy, dx) - start_angle_) / step;
+                t -= fn * std::floor(t / fn);
+                size_t k = std::min(static_cast<size_t>(t), n - 1);
+                float f = t - k;
+
+                // distance (pixels) to the nearest sector edge and the sector behind it
+                bool lower = f < 0.5f;
+                float edge_angle = (lower ? f : 1.0f - f) * step;
+                float distance = r * std::sin(std::min(edge_angle, half_pi));
+                const RGBColor& own = colors_[k];
+                const RGBColor& neighbor = colors_[lower ? (k + n - 1) % n : (k + 1) % n];
+                const Vector2& normal = edge_normals_[lower ? k : (k + 1) % n];
+
+                float w = coverage(distance, normal.x, normal.y);
+                color.r = static_cast<uint8_t>(own.r * w + neighbor.r * (1.0f - w) + 0.5f);
+                color.g = static_cast<uint8_t>(own.g * w + neighbor.g * (1.0f - w) + 0.5f);
+                color.b = static_cast<uint8_t>(own.b * w + neighbor.b * (1.0f - w) + 0.5f);
+                color.a = static_cast<uint8_t>(own.a * w + neighbor.a * (1.0f - w) + 0.5f);
+            }
+            color.a = static_cast<uint8_t>(color.a * rim_coverage + 0.5f);
+            return color;
+        };
+
+        draw_pixels(static_cast<int32_t>(std::floor(cx - radius)), static_cast<int32_t>(std::floor(cy - radius)),
+                    static_cast<int32_t>(std::ceil(cx + radius)), static_cast<int32_t>(std::ceil(cy + radius)), shader);
+    }
+
+    // area of the unit pixel square on the inner side of a straight edge, for a pixel
+    // center at signed 'distance' from the edge (positive inside) and an edge normal
+    // of absolute components (nx, ny)
+    static inline float coverage(float distance, float nx, float ny) {
+        float a = std::max(nx, ny);
+        float b = std::min(nx, ny);
+        // the square projects onto the normal as [-h, h]; the section length ramps up
+        // over the first and last b, and is 1 / a in between
+        float h = 0.5f * (a + b);
+        float d = std::abs(distance);
+        float outside;
+        if (d >= h) {
+            outside = 0.0f;
+        } else if (d > h - b) {
+            float t = h - d;
+            outside = t * t / (2.0f * a * b);
+        } else {
+            outside = 0.5f - d / a;
+        }
+        return distance >= 0.0f ? 1.0f - outside : outside;
+    }
+
+    std::vector<RGBColor> colors_;
+    Vector2 center_;
+    float radius_;
+    float start_angle_;
+    float z_;
+    // scratch: |normal| of every sector edge, reallocated only when the sector count changes
+    std::vector<Vector2> edge_normals_;
+};
+
+}
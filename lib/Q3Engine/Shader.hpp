@@ -3,6 +3,7 @@
 #include "RGBColor.hpp"
 #include "Math.hpp"
 
+#include <cstddef>
 #include <cstdint>
 
 namespace q3 {
@@ -21,6 +22,13 @@ public:
 public:
     virtual std::size_t getContextSize() const = 0;
     virtual bool vertexShader(Vertex& v0, Vertex& v1, Vertex& v2, void* data0, void* data1, void* data2, void* context) = 0;
+    // optional per-vertex stage used by Rasterizer::drawBuffer: a shader whose vertex work does
+    // not depend on the triangle transforms the 'count' positions into 'out' and returns true,
+    // then vertexShader is skipped for the draw and setupContext fills each triangle's context
+    virtual bool transformVertices(const Vector3* /*positions*/, Vertex* /*out*/, std::size_t /*count*/) { return false; }
+    // per-triangle context for draws that took the transformVertices path; a shader with a
+    // non-empty context that overrides transformVertices must override this too
+    virtual void setupContext(void* /*data0*/, void* /*data1*/, void* /*data2*/, void* /*context*/) {}
     virtual RGBColor fragmentShader(const Triangle& triangle, const Barycentric& barycentric, void* data0, void* data1, void* data2, const void* context) = 0;
 };
 
@@ -1,20 +1,38 @@
 #include "lib/ArgCLITool/ArgParser.hpp"
 #include "lib/CMap/cmap.h"
-#include "lib/PixelMatrix/ConsoleColor.h"
 #include "lib/PixelMatrix/PixelMatrix.h"
 #include "lib/Q3Engine/Buffer.hpp"
+#include "lib/Q3Engine/FXAA.hpp"
 #include "lib/Q3Engine/Math.hpp"
 #include "lib/Q3Engine/Rasterizer.hpp"
+#include "lib/Q3Engine/SectorRasterizer.hpp"
 #include "lib/Q3Engine/Shader.hpp"
 #include "lib/Q3Engine/Texture.hpp"
 #include "lib/Q3Engine/Utils.hpp"
 #include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <random>
 #include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+enum class RouletteBackend {
+    TRIANGLES, // segments drawn as tessellated triangle fans
+    ANALYTIC   // segments drawn by q3::SectorRasterizer with analytic coverage
+};
 
 struct Config {
     int n_numbers;
@@ -26,10 +44,14 @@ struct Config {
     q3::RGBColor text_color;
     q3::RGBColor highlight_color;
     q3::Rasterizer::AA_MODE aa_mode;
+    q3::Rasterizer::SampleLayout sample_layout;
+    bool fxaa;
+    RouletteBackend backend;
     int max_fps;
     int max_tps;
     bool show_metrics;
     bool precise_timing;
+    bool benchmark;
 } config;
 
 // q3::Texture numbers[] = {
@@ -47,38 +69,46 @@ struct Config {
 constexpr int TEXTURE_WIDTH = 200;
 constexpr int TEXTURE_HEIGHT = 400;
 
+// The pixels are built directly in the aligned storage of GraphicsBuffer, which takes it without a copy
 q3::Texture numbers[] = {
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_0.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_1.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_2.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_3.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_4.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_5.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_6.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_7.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_8.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT)),
-    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(std::vector<q3::RGBColor>{
+    q3::Texture(std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(q3::GraphicsBuffer<q3::RGBColor>::Storage{
         #include "assets/number_9.data"
     }, TEXTURE_WIDTH, TEXTURE_HEIGHT))};
 
+// Per-vertex data layout of a Batch sampler (see Batch::getSampler)
+struct BatchVertexData {
+    q3::RGBColor& color;
+    q3::Vector2& uv;
+    uint32_t& texture_id;
+};
+
 class SolidShader : public q3::Shader {
 public:
     std::size_t getContextSize() const override { return 0; }
@@ -89,14 +119,19 @@ public:
         v2 = transform.dot(v2);
         return true;
     }
+    bool transformVertices(const q3::Vector3* positions, q3::Vertex* out, std::size_t count) override
+    {
+        q3::transformPoints(transform, positions, out, count);
+        return true;
+    }
     q3::RGBColor fragmentShader(const q3::Triangle& triangle, const q3::Barycentric& barycentric, void* data0, void* data1, void* data2, const void* context) override
     {
-        return color;
+        // Flat shading: the first vertex of the triangle provides the color
+        return reinterpret_cast<BatchVertexData*>(data0)->color;
     }
 
 public:
     q3::Matrix4 transform;
-    q3::RGBColor color = {0, 0, 0};
 };
 
 class TextShader : public q3::Shader {
@@ -109,25 +144,25 @@ public:
         v2 = transform.dot(v2);
         return true;
     }
+    bool transformVertices(const q3::Vector3* positions, q3::Vertex* out, std::size_t count) override
+    {
+        q3::transformPoints(transform, positions, out, count);
+        return true;
+    }
     q3::RGBColor fragmentShader(const q3::Triangle& triangle, const q3::Barycentric& barycentric, void* data0, void* data1, void* data2, const void* context) override
     {
-        struct VertexData {
-            q3::Vector2& uv;
-        };
-
-        auto v0 = reinterpret_cast<VertexData*>(data0);
-        auto v1 = reinterpret_cast<VertexData*>(data1);
-        auto v2 = reinterpret_cast<VertexData*>(data2);
+        auto v0 = reinterpret_cast<BatchVertexData*>(data0);
+        auto v1 = reinterpret_cast<BatchVertexData*>(data1);
+        auto v2 = reinterpret_cast<BatchVertexData*>(data2);
         auto uv = q3::Shader::perspectiveCorrectInterpolate(v0->uv, v1->uv, v2->uv, triangle, barycentric);
 
         // Only draw pixel if alpha in texture is non-zero (avoid rendering background)
-        return texture.sample(uv).a != 0 ? color : q3::RGBColor{0, 0, 0, 0};
+        return textures[v0->texture_id].sample(uv).a != 0 ? v0->color : q3::RGBColor{0, 0, 0, 0};
     }
 
 public:
     q3::Matrix4 transform;
-    q3::Texture texture;
-    q3::RGBColor color;
+    std::vector<q3::Texture> textures;
 };
 
 class Object {
@@ -137,16 +172,18 @@ public:
           indices(std::make_shared<q3::DataBuffer<uint32_t>>()),
           uvs(std::make_shared<q3::DataBuffer<q3::Vector2>>())
     {
-        updateMatrix();
+        updateTransform();
     }
 
     void rotateBufferData(float angle)
     {
+        float c = std::cos(angle);
+        float s = std::sin(angle);
         for (auto& vertex : *vertices) {
             float x = vertex.x;
             float y = vertex.y;
-            vertex.x = x * std::cos(angle) - y * std::sin(angle);
-            vertex.y = x * std::sin(angle) + y * std::cos(angle);
+            vertex.x = x * c - y * s;
+            vertex.y = x * s + y * c;
         }
     }
 
@@ -169,21 +206,28 @@ public:
     }
 
     void setRotation(float angle)
+    {
+        setRotation(angle, {std::cos(angle), std::sin(angle)});
+    }
+
+    // Same as setRotation(angle) with a precomputed direction (cos(angle), sin(angle))
+    void setRotation(float angle, q3::Vector2 direction)
     {
         rotation = angle;
-        updateMatrix();
+        rotation_direction = direction;
+        updateTransform();
     }
 
     void setScale(float sx, float sy, float sz = 1.0f)
     {
         scale = {sx, sy, sz};
-        updateMatrix();
+        updateTransform();
     }
 
     void setTranslation(float tx, float ty, float tz = 0.0f)
     {
         translation = {tx, ty, tz};
-        updateMatrix();
+        updateTransform();
     }
 
     void setColor(q3::RGBColor color) { this->color = std::move(color); }
@@ -194,28 +238,26 @@ public:
     const q3::Vector3& getScale() const { return scale; }
     const q3::Vector3& getTranslation() const { return translation; }
     float getRotation() const { return rotation; }
-    const q3::Matrix4& getTransformMatrix() const { return transform_matrix; }
+    const q3::Affine2D& getTransform() const { return transform; }
+    q3::Matrix4 getTransformMatrix() const { return transform.toMatrix4(); }
     const q3::RGBColor& getColor() const { return color; }
     const std::shared_ptr<q3::DataBuffer<q3::Vector3>>& getVertices() const { return vertices; }
     const std::shared_ptr<q3::DataBuffer<uint32_t>>& getIndices() const { return indices; }
     const std::shared_ptr<q3::DataBuffer<q3::Vector2>>& getUVs() const { return uvs; }
 
 protected:
-    void updateMatrix()
+    void updateTransform()
     {
-        q3::Matrix4 scale_m = q3::createScaleMatrix(scale);
-        q3::Matrix4 rotate_m = q3::createRotationMatrix(rotation, {0.0f, 0.0f, -1.0f});
-        q3::Matrix4 translate_m = q3::createTranslationMatrix(translation);
-
-        // Apply scale -> then rotate -> then translate (SRT order)
-        transform_matrix = translate_m.dot(rotate_m).dot(scale_m);
+        // Apply scale -> then rotate (clockwise) -> then translate (SRT order)
+        transform = q3::createTransformAffine(scale, rotation_direction.x, -rotation_direction.y, translation);
     }
 
 protected:
     q3::Vector3 scale = {1.0f, 1.0f, 1.0f};
     q3::Vector3 translation = {0.0f, 0.0f, 0.0f};
     float rotation = 0.0f;
-    q3::Matrix4 transform_matrix;
+    q3::Vector2 rotation_direction = {1.0f, 0.0f};
+    q3::Affine2D transform;
     q3::RGBColor color = {0, 0, 0};
     std::shared_ptr<q3::DataBuffer<q3::Vector3>> vertices;
     std::shared_ptr<q3::DataBuffer<uint32_t>> indices;
@@ -230,6 +272,17 @@ public:
         generateVertices();
     }
 
+    // Smallest number of triangles for a fan spanning 'angle' whose chord error
+    // (distance between arc and triangle edge) stays below 'tolerance'
+    // pixel_radius and tolerance are both measured in samples
+    static int trianglesForTolerance(float angle, float pixel_radius, float tolerance)
+    {
+        if (pixel_radius <= tolerance) { return 1; }
+        // A chord spanning 'step' deviates from the arc by r * (1 - cos(step / 2))
+        float max_step = 2 * std::acos(1 - tolerance / pixel_radius);
+        return std::max(1, static_cast<int>(std::ceil(angle / max_step)));
+    }
+
 private:
     void generateVertices()
     {
@@ -302,7 +355,7 @@ private:
     void updateBufferData()
     {
         generateBufferData();
-        updateMatrix();
+        updateTransform();
     }
 
     void updateDimensions()
@@ -336,16 +389,102 @@ private:
     float height = 0.0f;
 };
 
+class Batch {
+public:
+    Batch()
+        : vertices(std::make_shared<q3::DataBuffer<q3::Vector3>>()),
+          indices(std::make_shared<q3::DataBuffer<uint32_t>>()),
+          colors(std::make_shared<q3::DataBuffer<q3::RGBColor>>()),
+          uvs(std::make_shared<q3::DataBuffer<q3::Vector2>>()),
+          texture_ids(std::make_shared<q3::DataBuffer<uint32_t>>())
+    {
+    }
+
+    // Merge an object into the batch, baking its current transform into the vertices
+    // Returns the index used to address the object in setColor
+    size_t append(const Object& object, uint32_t texture_id = 0)
+    {
+        const q3::Affine2D& transform = object.getTransform();
+        const auto& object_vertices = *object.getVertices();
+        const auto& object_uvs = *object.getUVs();
+        uint32_t base = static_cast<uint32_t>(vertices->size());
+
+        vertices->resize(base + object_vertices.size());
+        q3::transformPoints(transform, object_vertices.data(), vertices->data() + base, object_vertices.size());
+        for (size_t i = 0; i < object_vertices.size(); ++i) {
+            colors->push_back(object.getColor());
+            uvs->push_back(i < object_uvs.size() ? object_uvs[i] : q3::Vector2{});
+            texture_ids->push_back(texture_id);
+        }
+        for (uint32_t index : *object.getIndices()) {
+            indices->push_back(base + index);
+        }
+        ranges.push_back({base, static_cast<uint32_t>(vertices->size())});
+
+        // The sampler references vertex data and must be rebuilt after the buffers grow
+        sampler = nullptr;
+        return ranges.size() - 1;
+    }
+
+    void setColor(size_t object_index, q3::RGBColor color)
+    {
+        for (uint32_t i = ranges[object_index].first; i < ranges[object_index].second; ++i) {
+            (*colors)[i] = color;
+        }
+    }
+
+    void clear()
+    {
+        vertices->clear();
+        indices->clear();
+        colors->clear();
+        uvs->clear();
+        texture_ids->clear();
+        ranges.clear();
+        sampler = nullptr;
+    }
+
+    // Sampler providing BatchVertexData for every vertex
+    q3::BaseDataBufferSampler& getSampler()
+    {
+        if (!sampler) {
+            sampler = std::make_unique<q3::AutoDataBufferSampler>(colors, uvs, texture_ids);
+        }
+        return *sampler;
+    }
+
+    const q3::DataBuffer<q3::Vector3>& getVertices() const { return *vertices; }
+    const q3::DataBuffer<uint32_t>& getIndices() const { return *indices; }
+
+private:
+    std::shared_ptr<q3::DataBuffer<q3::Vector3>> vertices;
+    std::shared_ptr<q3::DataBuffer<uint32_t>> indices;
+    std::shared_ptr<q3::DataBuffer<q3::RGBColor>> colors;
+    std::shared_ptr<q3::DataBuffer<q3::Vector2>> uvs;
+    std::shared_ptr<q3::DataBuffer<uint32_t>> texture_ids;
+    // [first, last) vertex range of each appended object
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    std::unique_ptr<q3::AutoDataBufferSampler> sampler;
+};
+
 class Roulette {
 public:
-    Roulette(size_t n_numbers, float radius, q3::RGBColor text_color, q3::RGBColor highlight_color, int n_triangles = 50)
-        : n_numbers(n_numbers), radius(radius), text_color(text_color), highlight_color(highlight_color), n_triangles(n_triangles)
+    Roulette(size_t n_numbers, float radius, q3::RGBColor text_color, q3::RGBColor highlight_color, float chord_tolerance = 0.5f)
+        : n_numbers(n_numbers), radius(radius), text_color(text_color), highlight_color(highlight_color), chord_tolerance(chord_tolerance)
     {
         angle_step = 2 * M_PI / n_numbers;
-        generateFanAndTextBox();
+        generateSegmentDirections();
+        identity_transform = q3::createScaleMatrix({1.0f, 1.0f, 1.0f});
+        texture_shader.textures.assign(std::begin(numbers), std::end(numbers));
+        generateFans(1);
+        generateSectors();
+        generateTextBoxes();
         generatePin();
     }
 
+    void setBackend(RouletteBackend backend) { this->backend = backend; }
+    RouletteBackend getBackend() const { return backend; }
+
     void setRotation(float angle)
     {
         rotation = angle;
@@ -361,15 +500,30 @@ public:
     void setSize(float size)
     {
         radius = size;
+        // Force the fans to be regenerated with the new radius on the next render
+        tessellation_radius = -1.0f;
         updateObjects();
     }
 
+    // Re-tessellate the fans for a wheel spanning 'pixel_radius' samples on screen
+    // Geometry is only regenerated when the projected radius changes (size or AA mode)
+    void updateTessellation(float pixel_radius)
+    {
+        if (pixel_radius == tessellation_radius) { return; }
+        tessellation_radius = pixel_radius;
+        generateFans(Fan::trianglesForTolerance(angle_step, pixel_radius, chord_tolerance));
+    }
+
+    // The fans and text boxes are not drawn (the batches are), so they are only
+    // brought up to the current rotation when they are asked for
     Fan& getFan(int index)
     {
         if (index < 1 || index > n_numbers) {
             throw std::out_of_range("Index out of range");
         }
-        return fans[index - 1];
+        size_t i = index - 1;
+        fans[i].setRotation(rotation + i * angle_step, segmentDirection(i, frameDirection()));
+        return fans[i];
     }
 
     TextBox& getTextBox(int index)
@@ -377,7 +531,10 @@ public:
         if (index < 1 || index > n_numbers) {
             throw std::out_of_range("Index out of range");
         }
-        return text_boxes[index - 1];
+        size_t i = index - 1;
+        text_boxes[i].setRotation(rotation + i * angle_step, segmentDirection(i, frameDirection()));
+        text_boxes[i].setColor(index == getPointedNumber() ? highlight_color : text_color);
+        return text_boxes[i];
     }
 
     int calculatePointedNumber(float rotation) const
@@ -397,48 +554,147 @@ public:
         return calculatePointedNumber(rotation);
     }
 
+    // Layers are submitted back to front (fans, labels, pin), so the scene
+    // renders correctly without a depth buffer
     void render(q3::Rasterizer& rasterizer)
     {
-        // Draw all the fans and text boxes
-        for (size_t i = 0; i < n_numbers; ++i) {
-            // Set fan rotation based on index and the current global rotation
-            float fan_rotation = rotation + i * angle_step;
-            fans[i].setRotation(fan_rotation);
-            solid_shader.transform = fans[i].getTransformMatrix();
-            solid_shader.color = fans[i].getColor();
-            rasterizer.drawBuffer(*fans[i].getVertices(), *fans[i].getIndices(), solid_shader, dummy_sampler);
+        renderWheel(rasterizer);
+        renderPin(rasterizer);
+    }
 
-            // Draw the text box corresponding to the number
-            text_boxes[i].setRotation(fan_rotation);
-            q3::AutoDataBufferSampler text_box_sampler(text_boxes[i].getUVs());
-            texture_shader.texture = text_boxes[i].getText();
-            texture_shader.transform = text_boxes[i].getTransformMatrix();
-            texture_shader.color = text_boxes[i].getColor();
-            rasterizer.drawBuffer(*text_boxes[i].getVertices(), *text_boxes[i].getIndices(), texture_shader, text_box_sampler);
-        }
+    // Pixel rectangle covered by the wheel disc on a width x height framebuffer
+    q3::Rect getWheelRect(uint32_t width, uint32_t height) const
+    {
+        float pixel_radius = radius * 0.5f * std::min(width, height);
+        float cx = width * 0.5f;
+        float cy = height * 0.5f;
+        return {static_cast<int32_t>(std::floor(cx - pixel_radius)), static_cast<int32_t>(std::floor(cy - pixel_radius)),
+                static_cast<int32_t>(std::ceil(cx + pixel_radius)), static_cast<int32_t>(std::ceil(cy + pixel_radius))};
+    }
 
-        // Draw the pin
-        for (const auto& pin_part : pin) {
-            solid_shader.transform = pin_part.getTransformMatrix();
-            solid_shader.color = pin_part.getColor();
-            rasterizer.drawBuffer(*pin_part.getVertices(), *pin_part.getIndices(), solid_shader, dummy_sampler);
+    // The rotating part of the scene: fans and labels
+    void renderWheel(q3::Rasterizer& rasterizer)
+    {
+        // The fan and label batches are stored in wheel space, so a single
+        // rotation places every segment for the current frame
+        q3::Matrix4 wheel_transform = q3::createRotationZAffine(-rotation).toMatrix4();
+
+        // Fans and the pin are opaque and skip blending; labels and the
+        // anti-aliased rim of the analytic backend need alpha blending.
+        // The analytic sectors carry their own coverage and go straight into the
+        // output framebuffer, so the samples are to be resolved over it (resolveOver)
+        const q3::Rasterizer::DrawState previous_state = rasterizer.getDrawState();
+        q3::Rasterizer::DrawState opaque_state = previous_state;
+        q3::Rasterizer::DrawState blended_state = previous_state;
+        opaque_state.blend_mode = q3::Rasterizer::BlendMode::REPLACE;
+        blended_state.blend_mode = q3::Rasterizer::BlendMode::ALPHA;
+
+        // Draw all the fans
+        if (backend == RouletteBackend::ANALYTIC) {
+            rasterizer.setDrawState(blended_state);
+            // Fan i is centered at angle -(rotation + i * angle_step)
+            sector_rasterizer.setRadius(radius);
+            sector_rasterizer.setStartAngle(-rotation - angle_step / 2);
+            sector_rasterizer.drawOutput(rasterizer);
+        } else {
+            // Edge positions finer than a quarter pixel are indistinguishable after the
+            // resolve, so higher AA levels do not refine the tessellation any further
+            const auto& framebuffer = *rasterizer.getFramebuffer();
+            uint32_t viewport_size = std::min(framebuffer.getWidth(), framebuffer.getHeight());
+            uint32_t edge_steps = std::min<uint32_t>(rasterizer.getSampleCount(), 4);
+            updateTessellation(radius * 0.5f * viewport_size * edge_steps);
+
+            rasterizer.setDrawState(opaque_state);
+            solid_shader.transform = wheel_transform;
+            rasterizer.drawBuffer(fan_batch.getVertices(), fan_batch.getIndices(), solid_shader, fan_batch.getSampler());
         }
+
+        // Draw all the text boxes
+        rasterizer.setDrawState(blended_state);
+        texture_shader.transform = wheel_transform;
+        rasterizer.drawBuffer(label_batch.getVertices(), label_batch.getIndices(), texture_shader, label_batch.getSampler());
+
+        rasterizer.setDrawState(previous_state);
+    }
+
+    // The static part of the scene: the pin never moves, so it can be rendered
+    // once into a cached layer and composited over every frame
+    void renderPin(q3::Rasterizer& rasterizer)
+    {
+        const q3::Rasterizer::DrawState previous_state = rasterizer.getDrawState();
+        q3::Rasterizer::DrawState opaque_state = previous_state;
+        opaque_state.blend_mode = q3::Rasterizer::BlendMode::REPLACE;
+
+        rasterizer.setDrawState(opaque_state);
+        solid_shader.transform = identity_transform;
+        rasterizer.drawBuffer(pin_batch.getVertices(), pin_batch.getIndices(), solid_shader, pin_batch.getSampler());
+
+        rasterizer.setDrawState(previous_state);
     }
 
 private:
-    void generateFanAndTextBox()
+    void generateFans(int triangles_per_fan)
     {
+        fans.clear();
+        fan_batch.clear();
         auto cmap = cm::CMap::palettes["accent"].setRange(0, n_numbers);
+        q3::Vector2 frame_direction = frameDirection();
         for (size_t i = 0; i < n_numbers; ++i) {
             // Create each fan
-            Fan fan(radius, angle_step, std::max<int>(n_triangles / n_numbers, 1));
+            Fan fan(radius, angle_step, triangles_per_fan);
             auto color = cmap[i];
             fan.setColor({color.R, color.G, color.B});
+            fan.setRotation(i * angle_step, segment_directions[i]);
+            fan_batch.append(fan);
+            fan.setRotation(rotation + i * angle_step, segmentDirection(i, frame_direction));
             fans.push_back(std::move(fan));
+        }
+    }
+
+    // Unit direction of every segment offset i * angle_step, fixed for the wheel
+    void generateSegmentDirections()
+    {
+        segment_directions.resize(n_numbers);
+        for (size_t i = 0; i < n_numbers; ++i) {
+            float angle = i * angle_step;
+            segment_directions[i] = {std::cos(angle), std::sin(angle)};
+        }
+    }
+
+    q3::Vector2 frameDirection() const
+    {
+        return {std::cos(rotation), std::sin(rotation)};
+    }
+
+    // Direction of segment i rotated by the frame rotation:
+    // cos(a + b) = cos a cos b - sin a sin b, sin(a + b) = sin a cos b + cos a sin b
+    q3::Vector2 segmentDirection(size_t i, q3::Vector2 frame_direction) const
+    {
+        const q3::Vector2& offset = segment_directions[i];
+        return {frame_direction.x * offset.x - frame_direction.y * offset.y,
+                frame_direction.y * offset.x + frame_direction.x * offset.y};
+    }
+
+    void generateSectors()
+    {
+        // Sectors are laid out counter-clockwise while fans advance clockwise
+        auto cmap = cm::CMap::palettes["accent"].setRange(0, n_numbers);
+        std::vector<q3::RGBColor> colors(n_numbers);
+        for (size_t k = 0; k < n_numbers; ++k) {
+            auto color = cmap[(n_numbers - k) % n_numbers];
+            colors[k] = {color.R, color.G, color.B};
+        }
+        sector_rasterizer.setColors(std::move(colors));
+    }
 
+    void generateTextBoxes()
+    {
+        for (size_t i = 0; i < n_numbers; ++i) {
             // Create each text box (numbers 1-9 in a loop)
             TextBox text_box(numbers[i % 9 + 1]);
             text_box.setColor(text_color);
+            text_box.setRotation(i * angle_step, segment_directions[i]);
+            label_batch.append(text_box, i % 9 + 1);
             text_boxes.push_back(std::move(text_box));
         }
     }
@@ -456,20 +712,24 @@ private:
         pin_shadow.setTranslation(0.0f, -0.7f, -0.1f);
         pin_shadow.scaleBufferData(1.2f, 1.2f, 1.0f);
 
-        pin.push_back(std::move(pin_face));
+        // Painter's order: the shadow lies behind the face
+        pin_batch.append(pin_shadow);
+        pin_batch.append(pin_face);
+
         pin.push_back(std::move(pin_shadow));
+        pin.push_back(std::move(pin_face));
     }
 
     void updateObjects()
     {
         int pointed_number = getPointedNumber();
 
-        // Update each fan's position and text box's position
-        for (size_t i = 0; i < n_numbers; ++i) {
-            float fan_rotation = rotation + i * angle_step;
-            fans[i].setRotation(fan_rotation);
-            text_boxes[i].setRotation(fan_rotation);
-            text_boxes[i].setColor(i + 1 == pointed_number ? highlight_color : text_color);
+        // The batches are drawn with a single wheel rotation, so per segment only
+        // the labels whose highlight changed need their batched colors rewritten
+        if (pointed_number != highlighted_number) {
+            if (highlighted_number > 0) { label_batch.setColor(highlighted_number - 1, text_color); }
+            label_batch.setColor(pointed_number - 1, highlight_color);
+            highlighted_number = pointed_number;
         }
     }
 
@@ -478,9 +738,10 @@ private:
     float radius;
     q3::RGBColor text_color;
     q3::RGBColor highlight_color;
-    int n_triangles;
     float angle_step;
     float rotation = 0.0f;
+    // (cos, sin) of each segment offset i * angle_step
+    std::vector<q3::Vector2> segment_directions;
 
     // Fans and corresponding text boxes
     std::vector<Fan> fans;
@@ -489,10 +750,26 @@ private:
     // Winning number indicator
     std::vector<Fan> pin;
 
-    // Shaders and samplers
+    // Batched geometry submitted with one draw call each
+    // Fans and text boxes are baked in wheel space (rotation of segment i only)
+    Batch fan_batch;
+    Batch label_batch;
+    Batch pin_batch;
+    q3::Matrix4 identity_transform;
+    int highlighted_number = 0;
+
+    // Fan tessellation: maximum chord error in samples, and the projected
+    // radius (in samples) the current fan geometry was generated for
+    float chord_tolerance;
+    float tessellation_radius = 0.0f;
+
+    // Shaders
     SolidShader solid_shader;
     TextShader texture_shader;
-    q3::DummyDataBufferSampler dummy_sampler;
+
+    // Analytic backend
+    RouletteBackend backend = RouletteBackend::TRIANGLES;
+    q3::SectorRasterizer sector_rasterizer;
 };
 
 class RotationManager {
@@ -536,66 +813,80 @@ private:
     float remaining_angle;
 };
 
-class Renderer {
+// A frame handed from the logic thread to the render thread
+struct Frame {
+    std::shared_ptr<q3::GraphicsBuffer<q3::RGBColor>> buffer;
+    // Region that differs from the static frame (kept by the logic thread)
+    q3::Rect drawn = q3::Rect::emptyRect();
+    // Publish order (1 for the first published frame, 0 before any)
+    uint64_t sequence = 0;
+};
+
+// Triple-buffered handoff between the logic thread and the render thread
+// The logic thread draws into the back frame and publishes it; the render thread
+// takes the latest published frame and reads it for as long as it needs, since
+// neither side can reach the other's frame. Only pointer swaps are locked.
+class FrameExchange {
 public:
-    Renderer(int width, int height)
-        : pixel_matrix(width, height)
+    FrameExchange(Frame back, Frame ready, Frame front)
+        : back(std::move(back)), ready(std::move(ready)), front(std::move(front))
     {
-        // Save cursor position
-        std::cout << "\033[s";
     }
 
-    void setBuffer(std::shared_ptr<q3::GraphicsBuffer<q3::RGBColor>> buffer)
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex);
-        framebuffer = buffer;
-    }
+    // Logic thread: the frame to draw into
+    Frame& getBackFrame() { return back; }
 
-    void render()
+    // Logic thread: publish the back frame, which is replaced by one the render thread is not reading
+    void publish()
     {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex);
-
-            // Copy the contents of framebuffer into the internal pixel_matrix
-            // This step must be locked to avoid reading from a buffer that is being changed
-            if (framebuffer) {
-                graphicsBufferToPixelMatrix(*framebuffer, pixel_matrix);
-            }
-        }
-
-        // Restore saved cursor position to overwrite previous frame
-        std::cout << "\033[u";
-
-        // Render the pixel matrix to console
-        std::cout << pixel_matrix << std::flush;
+        std::lock_guard<std::mutex> lock(mutex);
+        back.sequence = ++published;
+        std::swap(back, ready);
+        fresh = true;
     }
 
-private:
-    static void graphicsBufferToPixelMatrix(const q3::GraphicsBuffer<q3::RGBColor>& buffer, PixelMatrix& pixel_matrix)
-    {
-        for (uint32_t y = 0; y < buffer.getHeight(); ++y) {
-            for (uint32_t x = 0; x < buffer.getWidth(); ++x) {
-                auto color = buffer.getValue(x, y);
-                pixel_matrix[y][x].color = {color.r, color.g, color.b};
-                if (color.a == 0) {
-                    pixel_matrix.disable(y, x);
-                } else {
-                    pixel_matrix.enable(y, x);
-                }
-            }
+    // Render thread: the latest published frame, unchanged until the next call
+    const Frame& acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fresh) {
+            std::swap(front, ready);
+            fresh = false;
         }
+        return front;
     }
 
 private:
-    PixelMatrix pixel_matrix;
-
-    // Framebuffer to be rendered (shared from logic thread)
-    std::shared_ptr<q3::GraphicsBuffer<q3::RGBColor>> framebuffer;
-
-    // Mutex to protect framebuffer access between render and setBuffer
-    std::mutex buffer_mutex;
+    Frame back;
+    Frame ready;
+    Frame front;
+    bool fresh = false;
+    uint64_t published = 0;
+    std::mutex mutex;
 };
 
+// Whether the terminal understands REP ("CSI n b", repeat the preceding character)
+// Not every terminal that claims to be an xterm does, so only known ones get it;
+// the others receive the repeated glyphs instead.
+bool terminalSupportsRepeat()
+{
+    auto env = [](const char* name) {
+        const char* value = std::getenv(name);
+        return std::string(value != nullptr ? value : "");
+    };
+    auto startsWith = [](const std::string& value, const char* prefix) { return value.rfind(prefix, 0) == 0; };
+
+    std::string term = env("TERM");
+    std::string term_program = env("TERM_PROGRAM");
+    if (term.empty() || term == "dumb") return false;
+    // tmux interprets the escapes itself, whatever the outer terminal
+    if (!env("TMUX").empty() || startsWith(term, "tmux")) return true;
+    if (startsWith(term, "screen") || startsWith(term, "linux")) return false;
+    if (!env("XTERM_VERSION").empty()) return true;
+    return startsWith(term, "foot") || startsWith(term, "xterm-kitty") || startsWith(term, "wezterm") || startsWith(term, "contour") ||
+           term_program == "WezTerm" || term_program == "mintty";
+}
+
 class RateTimer {
 public:
     RateTimer(double target_rate_hz, bool high_precision = true)
@@ -658,6 +949,319 @@ private:
     double actual_rate = 0.0;
 };
 
+// Writes frames to the terminal from a dedicated thread, so a slow terminal (or SSH
+// connection) never blocks rendering. A terminal is reopened as a private non-blocking
+// descriptor and waited on with poll(), leaving the flags of the shared one alone;
+// other outputs (pipes, files) keep their blocking fd, which only blocks this thread.
+// One frame is written at a time: submit() only when !busy().
+class TerminalWriter {
+public:
+    explicit TerminalWriter(int fd = STDOUT_FILENO)
+        : fd(fd), private_fd(-1)
+    {
+        // A reopened file would start writing at its beginning, so only terminals are reopened
+        if (isatty(fd)) {
+            private_fd = open(("/proc/self/fd/" + std::to_string(fd)).c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC | O_NOCTTY);
+            if (private_fd != -1) this->fd = private_fd;
+        }
+        thread = std::thread([this]() { run(); });
+    }
+
+    // Writes the last frame, unless the terminal takes nothing for a poll timeout
+    ~TerminalWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work.notify_one();
+        thread.join();
+        if (private_fd != -1) close(private_fd);
+    }
+
+    bool busy() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+    // Write 'frame' then 'footer' in one writev(); the strings are swapped with the
+    // writer's, so the caller gets back the buffers of the previous frame to reuse
+    void submit(std::string& frame, std::string& footer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(this->frame, frame);
+        std::swap(this->footer, footer);
+        pending = true;
+        work.notify_one();
+    }
+
+    // Block until the submitted frame is written
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return !pending; });
+    }
+
+    // Frames completely written per second
+    double getWriteRate() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return write_rate.getActualRate();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work.wait(lock, [this]() { return pending || stopping; });
+            if (!pending) return;
+            lock.unlock();
+            bool written = write();
+            lock.lock();
+            if (written) write_rate.waitNext();
+            pending = false;
+            idle.notify_all();
+        }
+    }
+
+    bool isStopping() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stopping;
+    }
+
+    // Whether the whole frame was written
+    bool write()
+    {
+        iovec parts[2] = {{frame.data(), frame.size()}, {footer.data(), footer.size()}};
+        iovec* part = parts;
+        int count = 2;
+        while (count > 0) {
+            ssize_t written = writev(fd, part, count);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    // Time out to notice shutdown, then stop waiting for a stuck terminal
+                    pollfd ready{fd, POLLOUT, 0};
+                    if (poll(&ready, 1, poll_timeout_ms) == 0 && isStopping()) return false;
+                    continue;
+                }
+                // The terminal is gone, nothing left to show the frame on
+                return false;
+            }
+            // Skip what was written, across parts
+            size_t remaining = static_cast<size_t>(written);
+            while (count > 0 && remaining >= part->iov_len) {
+                remaining -= part->iov_len;
+                part++;
+                count--;
+            }
+            if (count > 0) {
+                part->iov_base = static_cast<char*>(part->iov_base) + remaining;
+                part->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+
+    static constexpr int poll_timeout_ms = 100;
+
+    int fd;
+    // Descriptor opened by the writer (-1 when writing to the fd it was given)
+    int private_fd;
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable idle;
+    bool pending = false;
+    bool stopping = false;
+    // Measures completed writes only, uncapped
+    RateTimer write_rate{0.0};
+    // Frame being written, and the line printed below it
+    std::string frame;
+    std::string footer;
+};
+
+class Renderer {
+public:
+    Renderer()
+    {
+        // Save cursor position, written by the writer ahead of the first frame
+        output.assign("\033[s");
+        writer.submit(output, output_footer);
+    }
+
+    // Encode published frame 'sequence' and hand it to the terminal writer, followed by
+    // 'footer'. A frame already rendered is skipped, and so is any frame while the
+    // terminal is still taking an earlier one; published frames superseded before they
+    // got their turn are counted as dropped, so a slow terminal shows the newest frames
+    // instead of falling behind. The buffer must not change while it is rendered.
+    bool render(const q3::GraphicsBuffer<q3::RGBColor>& buffer, uint64_t sequence, const std::string& footer = "")
+    {
+        if (sequence == rendered_sequence || writer.busy()) return false;
+        if (sequence > rendered_sequence + 1) dropped_frames += sequence - rendered_sequence - 1;
+        rendered_sequence = sequence;
+
+        // Restore saved cursor position to overwrite previous frame
+        output.assign("\033[u");
+
+        // Pack two framebuffer rows per console line, reading the pixels in place
+        int width = static_cast<int>(buffer.getWidth());
+        int height = static_cast<int>(buffer.getHeight());
+        if (cells.rows() != height || cells.cols() != width) cells = PixelMatrix(height, width);
+        for (int y = 0; y < height; y += 2) {
+            const q3::RGBColor* bottom = y + 1 < height ? buffer.row(y + 1).data() : nullptr;
+            cells.setLine(y >> 1, buffer.row(y).data(), bottom);
+        }
+
+        // Only the cells that changed since the last frame (everything on the first one)
+        cells.writeDelta(shown, encoder, output);
+        std::swap(cells, shown);
+
+        // Render the frame to console
+        output_footer.assign(footer);
+        writer.submit(output, output_footer);
+        return true;
+    }
+
+    // Wait until the terminal has taken the last frame
+    void flush() { writer.flush(); }
+
+    uint64_t getDroppedFrames() const { return dropped_frames; }
+
+    // Frames the terminal took per second
+    double getFrameRate() const { return writer.getWriteRate(); }
+
+private:
+    TerminalWriter writer;
+    uint64_t rendered_sequence = 0;
+    uint64_t dropped_frames = 0;
+    HalfBlockEncoder encoder{terminalSupportsRepeat()};
+    // Cells of the frame being encoded, and of the frame on screen
+    PixelMatrix cells{0, 0};
+    PixelMatrix shown{0, 0};
+    // Escape sequences of the current frame, and the footer (reused between frames)
+    std::string output;
+    std::string output_footer;
+};
+
+// Renders 'config.steps' frames spread over one turn of the wheel with every
+// antialiasing configuration (and sample layout), and reports the render cost
+// and the difference from 16x supersampling of the triangle fans
+void runBenchmark()
+{
+    using Layout = q3::Rasterizer::SampleLayout;
+    struct Mode {
+        const char* name;
+        q3::Rasterizer::AA_MODE aa_mode;
+        bool fxaa;
+        Layout layout;
+        RouletteBackend backend;
+    };
+    const RouletteBackend backend = config.backend;
+    std::vector<Mode> modes = {
+        {"none", q3::Rasterizer::AA_MODE::NONE, false, Layout::INTERLEAVED, backend},
+        {"fxaa", q3::Rasterizer::AA_MODE::NONE, true, Layout::INTERLEAVED, backend},
+        {"2x", q3::Rasterizer::AA_MODE::SSAA_2X, false, Layout::INTERLEAVED, backend},
+        {"2x+fxaa", q3::Rasterizer::AA_MODE::SSAA_2X, true, Layout::INTERLEAVED, backend},
+        {"4x", q3::Rasterizer::AA_MODE::SSAA_4X, false, Layout::INTERLEAVED, backend},
+        {"8x", q3::Rasterizer::AA_MODE::SSAA_8X, false, Layout::INTERLEAVED, backend},
+        {"16x", q3::Rasterizer::AA_MODE::SSAA_16X, false, Layout::INTERLEAVED, backend},
+        {"msaa4x", q3::Rasterizer::AA_MODE::MSAA_4X, false, Layout::INTERLEAVED, backend},
+        {"msaa8x", q3::Rasterizer::AA_MODE::MSAA_8X, false, Layout::INTERLEAVED, backend},
+        {"msaa16x", q3::Rasterizer::AA_MODE::MSAA_16X, false, Layout::INTERLEAVED, backend},
+        {"4x planar", q3::Rasterizer::AA_MODE::SSAA_4X, false, Layout::PLANAR, backend},
+        {"16x planar", q3::Rasterizer::AA_MODE::SSAA_16X, false, Layout::PLANAR, backend},
+        {"msaa16x planar", q3::Rasterizer::AA_MODE::MSAA_16X, false, Layout::PLANAR, backend},
+        {"4x tiled", q3::Rasterizer::AA_MODE::SSAA_4X, false, Layout::TILED, backend},
+        {"16x tiled", q3::Rasterizer::AA_MODE::SSAA_16X, false, Layout::TILED, backend},
+        {"msaa16x tiled", q3::Rasterizer::AA_MODE::MSAA_16X, false, Layout::TILED, backend},
+    };
+    // The analytic sectors against the triangle reference, whichever backend was chosen
+    if (backend != RouletteBackend::ANALYTIC) {
+        modes.push_back({"analytic", q3::Rasterizer::AA_MODE::NONE, false, Layout::INTERLEAVED, RouletteBackend::ANALYTIC});
+        modes.push_back({"analytic 4x", q3::Rasterizer::AA_MODE::SSAA_4X, false, Layout::INTERLEAVED, RouletteBackend::ANALYTIC});
+    }
+
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(config.size, config.size);
+    q3::Rasterizer rasterizer(framebuffer);
+    q3::FXAA fxaa;
+    Roulette roulette(config.n_numbers, config.radius, config.text_color, config.highlight_color);
+
+    // The analytic sectors are drawn into the output, under the samples resolved over them
+    auto renderFrame = [&](const Mode& mode, int frame) {
+        const q3::RGBColor background_color = {24, 24, 24, 0};
+        const bool analytic = mode.backend == RouletteBackend::ANALYTIC;
+        roulette.setBackend(mode.backend);
+        roulette.setRotation(2 * M_PI * frame / config.steps);
+        rasterizer.clearFrameBuffer(analytic ? q3::RGBColor{0, 0, 0, 0} : background_color);
+        if (analytic) { rasterizer.clearOutput(background_color, rasterizer.getViewportRect()); }
+        roulette.render(rasterizer);
+        if (analytic) {
+            rasterizer.resolveOver(rasterizer.getViewportRect());
+        } else {
+            rasterizer.resolve();
+        }
+        if (mode.fxaa) {
+            fxaa.setAntialiasedInput(analytic || rasterizer.getSampleCount() > 1);
+            fxaa.apply(*framebuffer);
+        }
+    };
+
+    // Reference frames
+    const Mode reference_mode = {"16x triangles", q3::Rasterizer::AA_MODE::SSAA_16X, false, Layout::INTERLEAVED, RouletteBackend::TRIANGLES};
+    std::vector<q3::GraphicsBuffer<q3::RGBColor>> reference;
+    rasterizer.setAntialiasingMode(reference_mode.aa_mode);
+    rasterizer.setSampleLayout(reference_mode.layout);
+    for (int frame = 0; frame < config.steps; ++frame) {
+        renderFrame(reference_mode, frame);
+        reference.push_back(*framebuffer);
+    }
+
+    std::cout << "Benchmark: " << config.n_numbers << " entries, " << config.size << "x" << config.size << " pixels, "
+              << config.steps << " frames, reference: " << reference_mode.name << "\n"
+              << std::left << std::setw(16) << "mode" << std::right << std::setw(12) << "ms/frame"
+              << std::setw(12) << "mean error" << std::setw(14) << "pixels > 16" << std::endl;
+
+    rasterizer.resetTriangleStats();
+    for (const Mode& mode : modes) {
+        rasterizer.setAntialiasingMode(mode.aa_mode);
+        rasterizer.setSampleLayout(mode.layout);
+        double render_time = 0.0;
+        uint64_t error_sum = 0;
+        uint64_t visible_errors = 0;
+        for (int frame = 0; frame < config.steps; ++frame) {
+            auto start = std::chrono::steady_clock::now();
+            renderFrame(mode, frame);
+            render_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Compare the visible color channels with the reference frame
+            for (uint32_t y = 0; y < framebuffer->getHeight(); ++y) {
+                const q3::RGBColor* pixels = (*framebuffer)[y];
+                const q3::RGBColor* expected = reference[frame][y];
+                for (uint32_t x = 0; x < framebuffer->getWidth(); ++x) {
+                    const q3::RGBColor& a = pixels[x];
+                    const q3::RGBColor& b = expected[x];
+                    int error = std::max({std::abs(a.r - b.r), std::abs(a.g - b.g), std::abs(a.b - b.b)});
+                    error_sum += error;
+                    visible_errors += error > 16;
+                }
+            }
+        }
+        double n_pixels = static_cast<double>(config.steps) * config.size * config.size;
+        std::cout << std::left << std::setw(16) << mode.name << std::right << std::fixed
+                  << std::setw(12) << std::setprecision(3) << render_time * 1000.0 / config.steps
+                  << std::setw(12) << std::setprecision(3) << error_sum / n_pixels
+                  << std::setw(13) << std::setprecision(2) << visible_errors * 100.0 / n_pixels << "%" << std::endl;
+    }
+
+    const q3::Rasterizer::TriangleStats& stats = rasterizer.getTriangleStats();
+    std::cout << "Triangles: " << stats.submitted << " submitted, " << stats.rejected << " rejected, " << stats.clipped << " clipped, "
+              << stats.degenerate << " degenerate, " << stats.face_culled << " face-culled" << std::endl;
+}
+
 std::string helpString(const std::string& program_name)
 {
     std::ostringstream oss;
@@ -671,11 +1275,19 @@ std::string helpString(const std::string& program_name)
         << "  -st, --steps <steps>     Number of animation steps (smoothness/speed, default: 200)\n"
         << "  --text-color <hex>       Hex color code for text color (default: 000000)\n"
         << "  --highlight-color <hex>  Hex color code for highlight color (default: FF0000)\n"
-        << "  --aa <mode>              Antialiasing mode: none, 2x, 4x, 8x, 16x (default: 4x)\n"
+        << "  --aa <mode>              Antialiasing mode: none, 2x, 4x, 8x, 16x samples per pixel,\n"
+        << "                           or msaa2x..msaa16x to shade once per pixel (default: 4x)\n"
+        << "  --sample-layout <layout> Storage of the --aa samples: interleaved (RGBA per sample),\n"
+        << "                           planar (one plane per channel) or tiled (8x8-pixel Z-order\n"
+        << "                           tiles) (default: interleaved)\n"
+        << "  --fxaa                   Apply FXAA post-process antialiasing after the --aa resolve (default: off)\n"
+        << "  --backend <backend>      Wheel renderer: triangles, analytic (default: triangles)\n"
         << "  --max-fps <fps>          Maximum FPS limit for rendering (0 = uncapped, default: 60)\n"
         << "  --max-tps <tps>          Maximum TPS limit for logic updates (0 = uncapped, default: 100)\n"
-        << "  --show-metrics           Show FPS/TPS stats in console output (default: off)\n"
+        << "  --show-metrics           Show FPS/TPS stats and dropped frames in console output (default: off)\n"
         << "  --precise-timing         Enable high-precision timing using busy wait (default: off)\n"
+        << "  --benchmark              Compare the cost and quality of all antialiasing modes over\n"
+        << "                           --steps frames, then exit\n"
         << "  -h,  --help              Show this help message and exit\n\n"
         << "Example:\n"
         << "  " << program_name << " 8 -sz 150 -r 20 -st 400 --aa 8x\n";
@@ -692,10 +1304,14 @@ int main(int argc, char* argv[])
     parser.add("--text-color").nvalues(1).defaultValues({"000000"});
     parser.add("--highlight-color").nvalues(1).defaultValues({"FF0000"});
     parser.add("--aa").nvalues(1).defaultValues({"4x"});
+    parser.add("--sample-layout").nvalues(1).defaultValues({"interleaved"});
+    parser.add("--fxaa");
+    parser.add("--backend").nvalues(1).defaultValues({"triangles"});
     parser.add("--max-fps").nvalues(1).defaultValues({"60"});
     parser.add("--max-tps").nvalues(1).defaultValues({"100"});
     parser.add("--show-metrics");
     parser.add("--precise-timing");
+    parser.add("--benchmark");
     parser.add("-h", "--help");
 
     ArgCLITool::Args args;
@@ -731,13 +1347,43 @@ int main(int argc, char* argv[])
             config.aa_mode = q3::Rasterizer::AA_MODE::SSAA_8X;
         } else if (aa_mode == "16x") {
             config.aa_mode = q3::Rasterizer::AA_MODE::SSAA_16X;
+        } else if (aa_mode == "msaa2x") {
+            config.aa_mode = q3::Rasterizer::AA_MODE::MSAA_2X;
+        } else if (aa_mode == "msaa4x") {
+            config.aa_mode = q3::Rasterizer::AA_MODE::MSAA_4X;
+        } else if (aa_mode == "msaa8x") {
+            config.aa_mode = q3::Rasterizer::AA_MODE::MSAA_8X;
+        } else if (aa_mode == "msaa16x") {
+            config.aa_mode = q3::Rasterizer::AA_MODE::MSAA_16X;
         } else {
             unknown_aa_mode = true;
         }
+        std::string sample_layout = args["--sample-layout"].as<std::string>();
+        bool unknown_sample_layout = false;
+        if (sample_layout == "interleaved") {
+            config.sample_layout = q3::Rasterizer::SampleLayout::INTERLEAVED;
+        } else if (sample_layout == "planar") {
+            config.sample_layout = q3::Rasterizer::SampleLayout::PLANAR;
+        } else if (sample_layout == "tiled") {
+            config.sample_layout = q3::Rasterizer::SampleLayout::TILED;
+        } else {
+            unknown_sample_layout = true;
+        }
+        config.fxaa = args["--fxaa"];
+        std::string backend = args["--backend"].as<std::string>();
+        bool unknown_backend = false;
+        if (backend == "triangles") {
+            config.backend = RouletteBackend::TRIANGLES;
+        } else if (backend == "analytic") {
+            config.backend = RouletteBackend::ANALYTIC;
+        } else {
+            unknown_backend = true;
+        }
         config.max_fps = args["--max-fps"].as<int>();
         config.max_tps = args["--max-tps"].as<int>();
         config.show_metrics = args["--show-metrics"];
         config.precise_timing = args["--precise-timing"];
+        config.benchmark = args["--benchmark"];
 
         // Sanity check on user input values
         if (config.n_numbers <= 0) { throw std::invalid_argument("Number of entries must be greater than 0"); }
@@ -745,6 +1391,8 @@ int main(int argc, char* argv[])
         if (config.rounds < 0) { throw std::invalid_argument("Number of rounds must be non-negative"); }
         if (config.steps <= 0) { throw std::invalid_argument("Number of steps must be greater than 0"); }
         if (unknown_aa_mode) { throw std::invalid_argument("Unknown antialiasing mode: " + aa_mode); }
+        if (unknown_sample_layout) { throw std::invalid_argument("Unknown sample layout: " + sample_layout); }
+        if (unknown_backend) { throw std::invalid_argument("Unknown backend: " + backend); }
         if (config.max_fps < 0) { throw std::invalid_argument("FPS limit must be non-negative"); }
         if (config.max_tps < 0) { throw std::invalid_argument("TPS limit must be non-negative"); }
     } catch (const std::exception& e) {
@@ -753,17 +1401,21 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    // Allocate two framebuffers for double buffering
-    // framebuffer_draw: used by logic thread to draw the next frame (back buffer)
-    // framebuffer_render: currently displayed by render thread (front buffer)
-    auto framebuffer_draw = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(config.size, config.size);
-    auto framebuffer_render = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(config.size, config.size);
+    if (config.benchmark) {
+        runBenchmark();
+        return 0;
+    }
 
-    // depthbuffer is shared by rasterizer (doesn't need double buffering)
-    auto depthbuffer = std::make_shared<q3::GraphicsBuffer<float>>(config.size, config.size);
+    // Allocate three framebuffers for triple buffering: the logic thread draws the
+    // back buffer while the render thread reads the latest published one in place
+    Frame output_frames[3];
+    for (Frame& frame : output_frames) {
+        frame.buffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(config.size, config.size);
+    }
 
     // Initialize a roulette wheel with text labels (1 ~ n)
-    Roulette roulette(config.n_numbers, config.radius, config.text_color, config.highlight_color, 50);
+    Roulette roulette(config.n_numbers, config.radius, config.text_color, config.highlight_color);
+    roulette.setBackend(config.backend);
 
     // Randomly pick a final angle for the roulette to stop at
     std::random_device rd;
@@ -775,11 +1427,59 @@ int main(int argc, char* argv[])
     RotationManager rotation_manager(stop_angle, config.steps);
 
     // Set up rasterizer for rendering the wheel (with AA settings)
-    q3::Rasterizer rasterizer(framebuffer_draw, depthbuffer);
+    // The roulette is drawn in painter's order, so no depth buffer is needed
+    q3::Rasterizer rasterizer(output_frames[0].buffer);
     rasterizer.setAntialiasingMode(config.aa_mode);
+    rasterizer.setSampleLayout(config.sample_layout);
+
+    // Optional post-process antialiasing of the resolved frame, lighter when the
+    // resolve or the analytic sectors already antialiased the edges
+    q3::FXAA fxaa;
+    fxaa.setAntialiasedInput(config.backend == RouletteBackend::ANALYTIC || rasterizer.getSampleCount() > 1);
+
+    // The pin never moves: render it once into a layer with premultiplied alpha
+    // (samples start fully transparent, so the resolve premultiplies coverage)
+    auto pin_layer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(config.size, config.size);
+    q3::Rect pin_rect;
+    {
+        q3::Rasterizer layer_rasterizer(pin_layer);
+        layer_rasterizer.setAntialiasingMode(config.aa_mode);
+        layer_rasterizer.setSampleLayout(config.sample_layout);
+        layer_rasterizer.clearFrameBuffer({0, 0, 0, 0});
+        roulette.renderPin(layer_rasterizer);
+        layer_rasterizer.resolve();
+        pin_rect = layer_rasterizer.getDirtyRect();
+    }
+
+    // The analytic backend draws its sectors straight into the frame, and only the labels go
+    // through the samples: they start transparent and are resolved over the frame
+    const bool analytic = config.backend == RouletteBackend::ANALYTIC;
+    const q3::RGBColor background_color = {24, 24, 24, 0};
+    const q3::RGBColor sample_clear_color = analytic ? q3::RGBColor{0, 0, 0, 0} : background_color;
+
+    // Static frame: the background with the pin composited on top, in every output buffer
+    for (const Frame& frame : output_frames) {
+        rasterizer.setBuffers(frame.buffer);
+        rasterizer.clearFrameBuffer(sample_clear_color);
+        if (analytic) {
+            rasterizer.clearOutput(background_color, rasterizer.getViewportRect());
+        } else {
+            rasterizer.resolve();
+        }
+        rasterizer.compositeLayer(*pin_layer, pin_rect);
+        if (config.fxaa) { fxaa.apply(*frame.buffer); }
+    }
+    rasterizer.resetDirtyRect();
+    FrameExchange frames(output_frames[0], output_frames[1], output_frames[2]);
+
+    // Only the wheel is rasterized every tick, and the scissor keeps it inside its disc
+    q3::Rasterizer::DrawState wheel_state = rasterizer.getDrawState();
+    wheel_state.scissor_test = true;
+    wheel_state.scissor = roulette.getWheelRect(config.size, config.size);
+    rasterizer.setDrawState(wheel_state);
 
     // Configure the renderer to draw framebuffer to the screen
-    Renderer renderer(config.size, config.size);
+    Renderer renderer;
 
     // Initialize two rate timers:
     // - render_timer: caps the render thread to max_fps (0 = uncapped)
@@ -791,14 +1491,19 @@ int main(int argc, char* argv[])
     std::atomic<bool> running = true;
     std::thread render_thread([&]() {
         while (running) {
-            // Render the current front buffer to the console
-            renderer.render();
-
-            // Conditionally print metrics only if enabled
+            // Conditionally print metrics below the frame only if enabled
+            std::string metrics;
             if (config.show_metrics) {
-                std::cout << "FPS/TPS: " << render_timer.getActualRate() << "/" << logic_timer.getActualRate() << std::endl;
+                std::ostringstream oss;
+                oss << "FPS/TPS: " << renderer.getFrameRate() << "/" << logic_timer.getActualRate()
+                    << ", dropped frames: " << renderer.getDroppedFrames() << "\n";
+                metrics = oss.str();
             }
 
+            // Render the latest published frame to the console (skipped while the terminal is busy)
+            const Frame& frame = frames.acquire();
+            renderer.render(*frame.buffer, frame.sequence, metrics);
+
             // Wait until next frame based on FPS limit (0 = uncapped)
             render_timer.waitNext();
         }
@@ -808,23 +1513,32 @@ int main(int argc, char* argv[])
         // Update the roulette angle for this animation step
         roulette.setRotation(rotation_manager.getCurrentAngle());
 
-        // Rasterizer will render into the back buffer (framebuffer_draw)
-        rasterizer.setBuffers(framebuffer_draw, depthbuffer);
-
-        // Clear the back buffer before drawing
-        rasterizer.clearFrameBuffer({24, 24, 24, 0});
-        rasterizer.clearDepthBuffer();
-
-        // Render the scene into framebuffer_draw
-        roulette.render(rasterizer);
-
-        // Swap the back and front buffers
-        // - framebuffer_draw becomes the new front buffer
-        // - framebuffer_render becomes the new back buffer for the next frame
-        std::swap(framebuffer_draw, framebuffer_render);
+        // Rasterizer will render into the back buffer
+        Frame& frame = frames.getBackFrame();
+        rasterizer.setBuffers(frame.buffer);
+
+        // Restore the static background where the previous tick drew into the render
+        // target, and where the back buffer still holds an older frame
+        q3::Rect stale = rasterizer.getDirtyRect().unite(frame.drawn);
+        rasterizer.clearFrameBuffer(sample_clear_color, stale);
+        if (analytic) { rasterizer.clearOutput(background_color, stale.unite(wheel_state.scissor)); }
+        rasterizer.resetDirtyRect();
+
+        // Render the wheel, then resolve and recomposite the pin over the changed region only
+        roulette.renderWheel(rasterizer);
+        q3::Rect drawn = rasterizer.getDirtyRect();
+        q3::Rect update = drawn.unite(stale);
+        if (analytic) {
+            rasterizer.resolveOver(update);
+        } else {
+            rasterizer.resolve(update);
+        }
+        rasterizer.compositeLayer(*pin_layer, update.intersect(pin_rect));
+        if (config.fxaa) { fxaa.apply(*frame.buffer, update); }
+        frame.drawn = drawn;
 
-        // Tell the renderer to use the newly rendered buffer as the front buffer
-        renderer.setBuffer(framebuffer_render);
+        // Hand the frame to the render thread and take a buffer it is not reading
+        frames.publish();
 
         // Wait until next logic tick based on TPS limit (0 = uncapped)
         logic_timer.waitNext();
@@ -835,4 +1549,9 @@ int main(int argc, char* argv[])
     if (render_thread.joinable()) {
         render_thread.join();
     }
+
+    // Make sure the final position is on screen
+    renderer.flush();
+    const Frame& frame = frames.acquire();
+    renderer.render(*frame.buffer, frame.sequence);
 }
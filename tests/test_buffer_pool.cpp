@@ -0,0 +1,110 @@
+// Reuse, zero-filling and the idle cap of GraphicsBufferPool
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/BufferPool.hpp"
+#include "../lib/Q3Engine/RGBColor.hpp"
+#include <cstdio>
+#include <memory>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+template<typename T>
+static size_t bufferBytes(const q3::GraphicsBuffer<T>& buffer)
+{
+    return buffer.getPitch() * buffer.getHeight() * sizeof(T);
+}
+
+// every byte of the storage, row padding included, is zero
+template<typename T>
+static bool isZero(const q3::GraphicsBuffer<T>& buffer)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(buffer.getData());
+    for (size_t i = 0; i < bufferBytes(buffer); i++) {
+        if (bytes[i] != 0) return false;
+    }
+    return true;
+}
+
+// acquire, scribble over every element and release, then acquire the same size again
+static void testReuse(uint32_t width, uint32_t height)
+{
+    q3::GraphicsBufferPool<q3::RGBColor> pool;
+    auto buffer = pool.acquire(width, height);
+    EXPECT(buffer->getWidth() == width && buffer->getHeight() == height);
+    EXPECT(buffer->getPitch() == q3::GraphicsBuffer<q3::RGBColor>::alignedPitch(width));
+    EXPECT(reinterpret_cast<uintptr_t>(buffer->getData()) % 64 == 0);
+    EXPECT(isZero(*buffer));
+    buffer->fill(q3::RGBColor(1, 2, 3, 4));
+    const size_t bytes = bufferBytes(*buffer);
+    const q3::RGBColor* storage = buffer->getData();
+
+    buffer = nullptr;
+    EXPECT(pool.getCachedBytes() == bytes);
+    buffer = pool.acquire(width, height);
+    EXPECT(buffer->getData() == storage);
+    EXPECT(pool.getCachedBytes() == 0);
+    EXPECT(isZero(*buffer));
+
+    // another size does not take the idle buffer
+    buffer = nullptr;
+    auto other = pool.acquire(width + 16, height);
+    EXPECT(other->getData() != storage);
+    EXPECT(pool.getCachedBytes() == bytes);
+}
+
+static void testIdleCap()
+{
+    const size_t bytes = q3::GraphicsBuffer<float>::alignedPitch(64) * 64 * sizeof(float);
+    q3::GraphicsBufferPool<float> pool(bytes);
+    auto first = pool.acquire(64, 64);
+    auto second = pool.acquire(64, 64);
+    const float* second_storage = second->getData();
+
+    // only one buffer fits under the cap: the oldest idle one is freed
+    first = nullptr;
+    second = nullptr;
+    EXPECT(pool.getCachedBytes() == bytes);
+    auto reused = pool.acquire(64, 64);
+    EXPECT(reused->getData() == second_storage);
+    reused = nullptr;
+
+    pool.trim();
+    EXPECT(pool.getCachedBytes() == 0);
+    pool.setMaxCachedBytes(bytes);
+    auto buffer = pool.acquire(64, 64);
+    buffer = nullptr;
+    EXPECT(pool.getCachedBytes() == bytes);
+    pool.setMaxCachedBytes(bytes - 1);
+    EXPECT(pool.getCachedBytes() == 0);
+}
+
+// buffers released after the pool is gone are simply freed
+static void testOutlivesPool()
+{
+    std::shared_ptr<q3::GraphicsBuffer<uint8_t>> buffer;
+    {
+        q3::GraphicsBufferPool<uint8_t> pool;
+        buffer = pool.acquire(100, 10);
+    }
+    buffer->fill(uint8_t(7));
+    EXPECT(buffer->getValue(99, 9) == 7);
+    buffer = nullptr;
+}
+
+int main()
+{
+    testReuse(37, 5);
+    // large enough for the mapped allocation path
+    testReuse(1000, 700);
+    testIdleCap();
+    testOutlivesPool();
+    if (failures == 0) std::printf("BufferPool: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
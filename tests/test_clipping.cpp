@@ -0,0 +1,162 @@
+// Clipping around the guard band, and the fill rule on shared edges
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include "../lib/Q3Engine/Shader.hpp"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+// White triangles, positions passed through as clip coordinates
+class WhiteShader : public q3::Shader {
+public:
+    std::size_t getContextSize() const override { return 0; }
+    bool vertexShader(q3::Vertex&, q3::Vertex&, q3::Vertex&, void*, void*, void*, void*) override { return true; }
+    q3::RGBColor fragmentShader(const q3::Triangle&, const q3::Barycentric&, void*, void*, void*, const void*) override
+    {
+        return q3::RGBColor(255, 255, 255, 255);
+    }
+};
+
+// number of white pixels, or -1 if a pixel differs from the edge x + y < edge (in NDC)
+static int checkHalfPlane(const q3::GraphicsBuffer<q3::RGBColor>& buffer, float edge)
+{
+    const int32_t width = static_cast<int32_t>(buffer.getWidth());
+    const int32_t height = static_cast<int32_t>(buffer.getHeight());
+    int count = 0;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const float ndc_x = (x + 0.5f) * 2.0f / width - 1.0f;
+            const float ndc_y = 1.0f - (y + 0.5f) * 2.0f / height;
+            const bool white = buffer[y][x].r == 255;
+            if (white != (ndc_x + ndc_y < edge)) return -1;
+            count += white;
+        }
+    }
+    return count;
+}
+
+static void testGuardBand()
+{
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(16, 16);
+    q3::Rasterizer rasterizer(framebuffer);
+    rasterizer.setAntialiasingMode(q3::Rasterizer::AA_MODE::NONE);
+    WhiteShader shader;
+    EXPECT(rasterizer.getGuardBand() == 4.0f);
+
+    // a triangle leaving the viewport but not the guard band is drawn without clipping;
+    // its hypotenuse, x + y = 0.3, passes between pixel centers
+    q3::DataBuffer<q3::Vector3> vertices;
+    q3::DataBuffer<uint32_t> indices{0, 1, 2};
+    q3::DummyDataBufferSampler sampler;
+    auto drawTriangle = [&](q3::Vector3 v0, q3::Vector3 v1, q3::Vector3 v2) {
+        vertices = {v0, v1, v2};
+        rasterizer.clearFrameBuffer();
+        rasterizer.resetTriangleStats();
+        rasterizer.drawBuffer(vertices, indices, shader, sampler);
+    };
+    auto draw = [&](float min, float max) {
+        drawTriangle({min, min, 0.0f}, {max, min, 0.0f}, {min, max, 0.0f});
+        return checkHalfPlane(*framebuffer, min + max);
+    };
+    int inside = draw(-3.0f, 3.3f);
+    EXPECT(inside > 0);
+    EXPECT(rasterizer.getTriangleStats().clipped == 0);
+
+    // the same edge from vertices beyond the guard band: clipped, and the same pixels
+    EXPECT(draw(-6.0f, 6.3f) == inside);
+    EXPECT(rasterizer.getTriangleStats().clipped == 1);
+
+    // a wider guard band takes the triangle without clipping
+    rasterizer.setGuardBand(8.0f);
+    EXPECT(draw(-6.0f, 6.3f) == inside);
+    EXPECT(rasterizer.getTriangleStats().clipped == 0);
+
+    // the guard band never shrinks below the viewport
+    rasterizer.setGuardBand(0.5f);
+    EXPECT(rasterizer.getGuardBand() == 1.0f);
+    EXPECT(draw(-3.0f, 3.3f) == inside);
+    EXPECT(rasterizer.getTriangleStats().clipped == 1);
+
+    // entirely beyond one edge of the viewport: rejected without being clipped
+    rasterizer.setGuardBand(4.0f);
+    drawTriangle({1.5f, -1.0f, 0.0f}, {5.0f, -1.0f, 0.0f}, {1.5f, 1.0f, 0.0f});
+    EXPECT(rasterizer.getTriangleStats().rejected == 1);
+    EXPECT(rasterizer.getTriangleStats().clipped == 0);
+    EXPECT(checkHalfPlane(*framebuffer, -4.0f) == 0);
+}
+
+// translucent white, blended once over black: 128 on every channel
+class TranslucentShader : public q3::Shader {
+public:
+    std::size_t getContextSize() const override { return 0; }
+    bool vertexShader(q3::Vertex&, q3::Vertex&, q3::Vertex&, void*, void*, void*, void*) override { return true; }
+    q3::RGBColor fragmentShader(const q3::Triangle&, const q3::Barycentric&, void*, void*, void*, const void*) override
+    {
+        return q3::RGBColor(255, 255, 255, 128);
+    }
+};
+
+// a mesh of translucent triangles whose shared horizontal, vertical and diagonal edges pass
+// through pixel centers: every sample inside the mesh is blended exactly once, so its
+// fully covered pixels all get the single-blend color (no seams of double blending, no cracks)
+static void testSharedEdges(q3::Rasterizer::AA_MODE mode)
+{
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(16, 16);
+    q3::Rasterizer rasterizer(framebuffer);
+    rasterizer.setAntialiasingMode(mode);
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+
+    // grid lines at the pixel centers 2.5, 5.5, ..., 14.5 (NDC multiples of 1/16, exact in float)
+    auto ndc_x = [](float x) { return x / 8.0f - 1.0f; };
+    auto ndc_y = [](float y) { return 1.0f - y / 8.0f; };
+    q3::DataBuffer<q3::Vector3> vertices;
+    q3::DataBuffer<uint32_t> indices;
+    for (int j = 0; j < 5; j++) {
+        for (int i = 0; i < 5; i++) vertices.push_back({ndc_x(2.5f + 3 * i), ndc_y(2.5f + 3 * j), 0.0f});
+    }
+    for (uint32_t j = 0; j < 4; j++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            const uint32_t a = j * 5 + i, b = a + 1, c = a + 5, d = a + 6;
+            // both diagonal directions, and both windings
+            if ((i + j) % 2 == 0) {
+                indices.insert(indices.end(), {a, b, d, a, d, c});
+            } else {
+                indices.insert(indices.end(), {a, c, b, b, c, d});
+            }
+        }
+    }
+    TranslucentShader shader;
+    q3::DummyDataBufferSampler sampler;
+    rasterizer.drawBuffer(vertices, indices, shader, sampler);
+    rasterizer.resolve();
+
+    int mismatches = 0;
+    for (uint32_t y = 3; y <= 13; y++) {
+        for (uint32_t x = 3; x <= 13; x++) {
+            const q3::RGBColor& pixel = (*framebuffer)[y][x];
+            if (pixel.r != 128 || pixel.g != 128 || pixel.b != 128) mismatches++;
+        }
+    }
+    EXPECT(mismatches == 0);
+}
+
+int main()
+{
+    using AA_MODE = q3::Rasterizer::AA_MODE;
+    testGuardBand();
+    for (AA_MODE mode : {AA_MODE::NONE, AA_MODE::SSAA_4X, AA_MODE::SSAA_16X, AA_MODE::MSAA_4X}) {
+        testSharedEdges(mode);
+    }
+    if (failures == 0) std::printf("Clipping: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// Triangle statistics for degenerate and face-culled triangles
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include "../lib/Q3Engine/Shader.hpp"
+#include <cstdio>
+#include <memory>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+// White triangles, positions passed through as clip coordinates
+class WhiteShader : public q3::Shader {
+public:
+    std::size_t getContextSize() const override { return 0; }
+    bool vertexShader(q3::Vertex&, q3::Vertex&, q3::Vertex&, void*, void*, void*, void*) override { return true; }
+    q3::RGBColor fragmentShader(const q3::Triangle&, const q3::Barycentric&, void*, void*, void*, const void*) override
+    {
+        return q3::RGBColor(255, 255, 255, 255);
+    }
+};
+
+struct Fixture {
+    std::shared_ptr<q3::GraphicsBuffer<q3::RGBColor>> framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(16, 16);
+    q3::Rasterizer rasterizer{framebuffer};
+    WhiteShader shader;
+    q3::DummyDataBufferSampler sampler;
+
+    Fixture() { rasterizer.setAntialiasingMode(q3::Rasterizer::AA_MODE::NONE); }
+
+    void setCullMode(q3::Rasterizer::CullMode mode) {
+        q3::Rasterizer::DrawState state = rasterizer.getDrawState();
+        state.cull_mode = mode;
+        rasterizer.setDrawState(state);
+    }
+
+    // draw one triangle from scratch, and return the number of white pixels
+    int draw(q3::Vector3 v0, q3::Vector3 v1, q3::Vector3 v2) {
+        q3::DataBuffer<q3::Vector3> vertices{v0, v1, v2};
+        q3::DataBuffer<uint32_t> indices{0, 1, 2};
+        rasterizer.clearFrameBuffer();
+        rasterizer.resetTriangleStats();
+        rasterizer.drawBuffer(vertices, indices, shader, sampler);
+        int white = 0;
+        for (uint32_t y = 0; y < framebuffer->getHeight(); y++) {
+            for (uint32_t x = 0; x < framebuffer->getWidth(); x++) white += (*framebuffer)[y][x].r == 255;
+        }
+        return white;
+    }
+
+    const q3::Rasterizer::TriangleStats& stats() const { return rasterizer.getTriangleStats(); }
+};
+
+static void testDegenerate()
+{
+    Fixture f;
+    // collinear vertices, and a repeated vertex: zero area, whatever the cull mode
+    for (q3::Rasterizer::CullMode mode : {q3::Rasterizer::CullMode::NONE, q3::Rasterizer::CullMode::BACK}) {
+        f.setCullMode(mode);
+        EXPECT(f.draw({-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 0.0f}, {0.5f, 0.5f, 0.0f}) == 0);
+        EXPECT(f.stats().submitted == 1 && f.stats().degenerate == 1 && f.stats().face_culled == 0);
+        EXPECT(f.draw({-0.5f, -0.5f, 0.0f}, {0.5f, -0.5f, 0.0f}, {0.5f, -0.5f, 0.0f}) == 0);
+        EXPECT(f.stats().degenerate == 1 && f.stats().face_culled == 0);
+    }
+    // a thin triangle is not degenerate
+    f.setCullMode(q3::Rasterizer::CullMode::NONE);
+    EXPECT(f.draw({-1.0f, -0.2f, 0.0f}, {1.0f, -0.2f, 0.0f}, {1.0f, 0.0f, 0.0f}) > 0);
+    EXPECT(f.stats().degenerate == 0);
+}
+
+static void testFaceCulling()
+{
+    using CullMode = q3::Rasterizer::CullMode;
+    Fixture f;
+    // counter-clockwise in NDC: a front face
+    const q3::Vector3 a{-0.5f, -0.5f, 0.0f}, b{0.5f, -0.5f, 0.0f}, c{0.0f, 0.5f, 0.0f};
+
+    f.setCullMode(CullMode::NONE);
+    const int covered = f.draw(a, b, c);
+    EXPECT(covered > 0);
+    EXPECT(f.draw(a, c, b) == covered);
+    EXPECT(f.stats().face_culled == 0);
+
+    f.setCullMode(CullMode::BACK);
+    EXPECT(f.draw(a, b, c) == covered);
+    EXPECT(f.stats().face_culled == 0);
+    EXPECT(f.draw(a, c, b) == 0);
+    EXPECT(f.stats().submitted == 1 && f.stats().face_culled == 1 && f.stats().degenerate == 0);
+
+    f.setCullMode(CullMode::FRONT);
+    EXPECT(f.draw(a, b, c) == 0);
+    EXPECT(f.stats().face_culled == 1);
+    EXPECT(f.draw(a, c, b) == covered);
+    EXPECT(f.stats().face_culled == 0);
+
+    // a back face beyond the guard band is clipped first, and its pieces are culled
+    f.setCullMode(CullMode::BACK);
+    EXPECT(f.draw({-6.0f, -6.0f, 0.0f}, {0.0f, 6.0f, 0.0f}, {6.0f, -6.0f, 0.0f}) == 0);
+    EXPECT(f.stats().clipped == 1 && f.stats().face_culled >= 1);
+}
+
+int main()
+{
+    testDegenerate();
+    testFaceCulling();
+    if (failures == 0) std::printf("Culling: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
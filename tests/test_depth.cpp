@@ -0,0 +1,150 @@
+// Hierarchical depth tiles and 16-bit depth against the visible result of float depth
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include "../lib/Q3Engine/Shader.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+using Buffer = q3::GraphicsBuffer<q3::RGBColor>;
+using DepthBuffer = q3::GraphicsBuffer<float>;
+
+class FlatShader : public q3::Shader {
+public:
+    q3::RGBColor color;
+    std::size_t getContextSize() const override { return 0; }
+    bool vertexShader(q3::Vertex&, q3::Vertex&, q3::Vertex&, void*, void*, void*, void*) override { return true; }
+    q3::RGBColor fragmentShader(const q3::Triangle&, const q3::Barycentric&, void*, void*, void*, const void*) override
+    {
+        return color;
+    }
+};
+
+// an opaque triangle at a constant NDC depth
+struct Layer {
+    float x0, y0, x1, y1, x2, y2;
+    float z;
+    q3::RGBColor color;
+};
+
+// large occluders first, so the tiles behind them reject whole draws, then layers in
+// front of and behind them, and thin slivers that leave tiles partly covered
+static const std::vector<Layer> layers = {
+    {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 0.2f, q3::RGBColor(200, 0, 0, 255)},
+    {1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 0.5f, q3::RGBColor(0, 200, 0, 255)},
+    {-0.9f, -0.8f, 0.7f, -0.7f, 0.1f, 0.9f, 0.6f, q3::RGBColor(0, 0, 200, 255)},
+    {-0.5f, -0.5f, 0.6f, -0.4f, 0.0f, 0.6f, -0.3f, q3::RGBColor(250, 250, 0, 255)},
+    {-0.95f, 0.3f, 0.95f, 0.35f, 0.0f, 0.33f, -0.6f, q3::RGBColor(0, 250, 250, 255)},
+    {0.3f, -0.95f, 0.35f, 0.95f, 0.32f, 0.0f, 0.9f, q3::RGBColor(250, 0, 250, 255)},
+    {-0.2f, -0.9f, 0.9f, 0.8f, -0.8f, 0.7f, 0.0f, q3::RGBColor(120, 60, 30, 255)},
+};
+
+static void drawLayer(q3::Rasterizer& rasterizer, const Layer& layer)
+{
+    FlatShader shader;
+    shader.color = layer.color;
+    q3::DummyDataBufferSampler sampler;
+    q3::DataBuffer<q3::Vector3> vertices{{layer.x0, layer.y0, layer.z}, {layer.x1, layer.y1, layer.z}, {layer.x2, layer.y2, layer.z}};
+    q3::DataBuffer<uint32_t> indices{0, 1, 2};
+    rasterizer.drawBuffer(vertices, indices, shader, sampler);
+}
+
+// the layers drawn back to front without a depth buffer: what the depth test must produce
+static std::shared_ptr<Buffer> renderPainter(q3::Rasterizer::AA_MODE mode)
+{
+    auto framebuffer = std::make_shared<Buffer>(45, 37);
+    q3::Rasterizer rasterizer(framebuffer);
+    rasterizer.setAntialiasingMode(mode);
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+    std::vector<Layer> sorted = layers;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Layer& a, const Layer& b) { return a.z > b.z; });
+    for (const Layer& layer : sorted) drawLayer(rasterizer, layer);
+    rasterizer.resolve();
+    return framebuffer;
+}
+
+// the layers in submission order with depth testing; setBuffers is called again before
+// every draw, as the main loop does every tick, and must keep the tiles valid
+static std::shared_ptr<Buffer> renderDepth(q3::Rasterizer::AA_MODE mode, q3::Rasterizer::DepthFormat format)
+{
+    auto framebuffer = std::make_shared<Buffer>(45, 37);
+    auto depthbuffer = std::make_shared<DepthBuffer>(45, 37);
+    q3::Rasterizer rasterizer(framebuffer, depthbuffer);
+    rasterizer.setAntialiasingMode(mode);
+    rasterizer.setDepthFormat(format);
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+    rasterizer.clearDepthBuffer();
+    for (const Layer& layer : layers) {
+        rasterizer.setBuffers(framebuffer, depthbuffer);
+        drawLayer(rasterizer, layer);
+    }
+    rasterizer.resolve();
+    return framebuffer;
+}
+
+static int countMismatches(const Buffer& a, const Buffer& b)
+{
+    int mismatches = 0;
+    for (uint32_t y = 0; y < a.getHeight(); y++) {
+        for (uint32_t x = 0; x < a.getWidth(); x++) {
+            const q3::RGBColor& p = a[y][x];
+            const q3::RGBColor& q = b[y][x];
+            if (p.r != q.r || p.g != q.g || p.b != q.b || p.a != q.a) mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static void testVisibleResult(q3::Rasterizer::AA_MODE mode)
+{
+    using Format = q3::Rasterizer::DepthFormat;
+    auto reference = renderPainter(mode);
+    EXPECT(countMismatches(*renderDepth(mode, Format::FLOAT32), *reference) == 0);
+    EXPECT(countMismatches(*renderDepth(mode, Format::UNORM16), *reference) == 0);
+}
+
+// another depth buffer of the same size has its own contents: the tiles of the first
+// one must not decide the depth tests of the second
+static void testSwappedDepthBuffer()
+{
+    auto framebuffer = std::make_shared<Buffer>(16, 16);
+    auto near_depth = std::make_shared<DepthBuffer>(16, 16, 0.0f);
+    auto far_depth = std::make_shared<DepthBuffer>(16, 16, 1.0f);
+    q3::Rasterizer rasterizer(framebuffer, far_depth);
+    rasterizer.setAntialiasingMode(q3::Rasterizer::AA_MODE::NONE);
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+    rasterizer.clearDepthBuffer();
+    const Layer full = {-1.0f, -1.0f, 3.0f, -1.0f, -1.0f, 3.0f, 0.0f, q3::RGBColor(255, 255, 255, 255)};
+
+    // everything behind the near buffer
+    rasterizer.setBuffers(framebuffer, near_depth);
+    drawLayer(rasterizer, full);
+    EXPECT((*framebuffer)[8][8].r == 0);
+
+    // everything in front of the far buffer
+    rasterizer.setBuffers(framebuffer, far_depth);
+    drawLayer(rasterizer, full);
+    EXPECT((*framebuffer)[8][8].r == 255);
+}
+
+int main()
+{
+    using AA_MODE = q3::Rasterizer::AA_MODE;
+    for (AA_MODE mode : {AA_MODE::NONE, AA_MODE::SSAA_4X, AA_MODE::MSAA_4X, AA_MODE::SSAA_16X}) {
+        testVisibleResult(mode);
+    }
+    testSwappedDepthBuffer();
+    if (failures == 0) std::printf("Depth: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
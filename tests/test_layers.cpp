@@ -0,0 +1,70 @@
+// Rect operations and the rounding of layer compositing
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include <cstdio>
+#include <memory>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+static void testRect()
+{
+    const q3::Rect a{0, 0, 9, 9};
+    const q3::Rect b{5, 5, 14, 14};
+    const q3::Rect c{20, 0, 29, 9};
+    const q3::Rect empty = q3::Rect::emptyRect();
+
+    EXPECT(empty.empty());
+    EXPECT(!a.empty());
+    const q3::Rect ab = a.intersect(b);
+    EXPECT(ab.min_x == 5 && ab.min_y == 5 && ab.max_x == 9 && ab.max_y == 9);
+    EXPECT(a.intersect(c).empty());
+
+    const q3::Rect ac = a.unite(c);
+    EXPECT(ac.min_x == 0 && ac.min_y == 0 && ac.max_x == 29 && ac.max_y == 9);
+    // empty rectangles do not grow the union, wherever their corners are
+    const q3::Rect ae = a.unite(empty);
+    EXPECT(ae.min_x == 0 && ae.min_y == 0 && ae.max_x == 9 && ae.max_y == 9);
+    const q3::Rect ea = empty.unite(a);
+    EXPECT(ea.min_x == 0 && ea.min_y == 0 && ea.max_x == 9 && ea.max_y == 9);
+    EXPECT(a.intersect(c).unite(empty).empty());
+}
+
+// compositeLayer rounds layer + framebuffer * (1 - alpha) to nearest, for every alpha and value
+static void testCompositeRounding()
+{
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(256, 256);
+    q3::GraphicsBuffer<q3::RGBColor> layer(256, 256);
+    for (int32_t alpha = 0; alpha < 256; alpha++) {
+        for (int32_t value = 0; value < 256; value++) {
+            (*framebuffer)[alpha][value] = q3::RGBColor(value, value, value, value);
+            layer[alpha][value] = q3::RGBColor(0, 0, 0, alpha);
+        }
+    }
+    q3::Rasterizer rasterizer(framebuffer);
+    rasterizer.compositeLayer(layer, q3::Rect{0, 0, 255, 255});
+
+    int mismatches = 0;
+    for (int32_t alpha = 0; alpha < 256; alpha++) {
+        for (int32_t value = 0; value < 256; value++) {
+            const int expected = (value * (255 - alpha) + 127) / 255;
+            if ((*framebuffer)[alpha][value].r != expected) mismatches++;
+        }
+    }
+    EXPECT(mismatches == 0);
+}
+
+int main()
+{
+    testRect();
+    testCompositeRounding();
+    if (failures == 0) std::printf("Layers: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
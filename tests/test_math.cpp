@@ -0,0 +1,119 @@
+// The SSE Matrix4 kernels against the generic scalar code, bit for bit
+#include "../lib/Q3Engine/Math.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+// a float that is not float: Matrix4T<Scalar> runs the generic templates, which the
+// SSE specializations replace for float, with the same float operations in the same order
+struct Scalar {
+    float v;
+    constexpr Scalar(float v = 0.0f) : v(v) {}
+    constexpr Scalar operator+(Scalar other) const { return v + other.v; }
+    constexpr Scalar operator*(Scalar other) const { return v * other.v; }
+};
+
+using ScalarMatrix = q3::Matrix4T<Scalar>;
+using ScalarVector = q3::Vector4T<Scalar>;
+
+static ScalarMatrix toScalar(const q3::Matrix4& matrix)
+{
+    ScalarMatrix result;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++) result[i][j] = matrix[i][j];
+    return result;
+}
+
+static ScalarVector toScalar(const q3::Vector4& vector)
+{
+    return {vector.position.x, vector.position.y, vector.position.z, vector.w};
+}
+
+static bool same(float a, Scalar b)
+{
+    return std::memcmp(&a, &b.v, sizeof(float)) == 0;
+}
+
+static bool same(const q3::Matrix4& a, const ScalarMatrix& b)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            if (!same(a[i][j], b[i][j])) return false;
+    return true;
+}
+
+static bool same(const q3::Vector4& a, const ScalarVector& b)
+{
+    return same(a.position.x, b.position.x) && same(a.position.y, b.position.y) && same(a.position.z, b.position.z) && same(a.w, b.w);
+}
+
+// deterministic values over several magnitudes and both signs, so products round
+static uint32_t state = 12345;
+static float randomValue()
+{
+    state = state * 1664525u + 1013904223u;
+    const float unit = static_cast<float>(state >> 8) / static_cast<float>(1u << 24) * 2.0f - 1.0f;
+    static const float scales[] = {1.0f, 0.001f, 37.0f, 1e5f};
+    return unit * scales[(state >> 4) % 4];
+}
+
+static q3::Matrix4 randomMatrix()
+{
+    q3::Matrix4 matrix;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++) matrix[i][j] = randomValue();
+    return matrix;
+}
+
+static void testProducts()
+{
+    int mismatches = 0;
+    for (int n = 0; n < 10000; n++) {
+        const q3::Matrix4 a = randomMatrix();
+        const q3::Matrix4 b = randomMatrix();
+        const q3::Vector4 v(randomValue(), randomValue(), randomValue(), randomValue());
+        if (!same(a.dot(b), toScalar(a).dot(toScalar(b)))) mismatches++;
+        if (!same(a.dot(v), toScalar(a).dot(toScalar(v)))) mismatches++;
+        if (!same(v.dot(a), toScalar(v).dot(toScalar(a)))) mismatches++;
+    }
+    EXPECT(mismatches == 0);
+}
+
+// the batched transform of points (w = 1) matches one matrix * vector product per point
+static void testTransformPoints()
+{
+    const q3::Matrix4 matrix = randomMatrix();
+    std::vector<q3::Vector3> points;
+    for (int n = 0; n < 1000; n++) points.push_back({randomValue(), randomValue(), randomValue()});
+    std::vector<q3::Vertex> vertices;
+    std::vector<q3::Vector3> positions;
+    q3::transformPoints(matrix, points, vertices);
+    q3::transformPoints(matrix, points, positions);
+
+    int mismatches = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        const ScalarVector expected = toScalar(matrix).dot(toScalar(q3::Vertex(points[i])));
+        if (!same(vertices[i], expected)) mismatches++;
+        if (!same(q3::Vector4(positions[i], expected.w.v), expected)) mismatches++;
+    }
+    EXPECT(mismatches == 0);
+}
+
+int main()
+{
+    testProducts();
+    testTransformPoints();
+    if (failures == 0) std::printf("Math: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+// MSAA coverage against SSAA for opaque, flat-shaded geometry
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include "../lib/Q3Engine/Shader.hpp"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+// one opaque color per draw, positions passed through as clip coordinates
+class FlatShader : public q3::Shader {
+public:
+    q3::RGBColor color;
+    std::size_t getContextSize() const override { return 0; }
+    bool vertexShader(q3::Vertex&, q3::Vertex&, q3::Vertex&, void*, void*, void*, void*) override { return true; }
+    q3::RGBColor fragmentShader(const q3::Triangle&, const q3::Barycentric&, void*, void*, void*, const void*) override
+    {
+        return color;
+    }
+};
+
+// a fan of differently colored sectors, as the wheel draws them: edges at many
+// slopes, shared between neighbouring triangles, and ending inside pixels
+static void drawFan(q3::Rasterizer& rasterizer, q3::Rasterizer::AA_MODE mode)
+{
+    constexpr uint32_t sectors = 7;
+    FlatShader shader;
+    q3::DummyDataBufferSampler sampler;
+    q3::DataBuffer<q3::Vector3> vertices(3);
+    q3::DataBuffer<uint32_t> indices{0, 1, 2};
+
+    rasterizer.setAntialiasingMode(mode);
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+    for (uint32_t i = 0; i < sectors; i++) {
+        const float a0 = 2.0f * 3.14159265f * i / sectors + 0.1f;
+        const float a1 = 2.0f * 3.14159265f * (i + 1) / sectors + 0.1f;
+        vertices[0] = q3::Vector3(0.03f, -0.02f, 0.0f);
+        vertices[1] = q3::Vector3(0.83f * std::cos(a0), 0.83f * std::sin(a0), 0.0f);
+        vertices[2] = q3::Vector3(0.83f * std::cos(a1), 0.83f * std::sin(a1), 0.0f);
+        shader.color = q3::RGBColor(static_cast<uint8_t>(40 * i), static_cast<uint8_t>(255 - 30 * i), 200, 255);
+        rasterizer.drawBuffer(vertices, indices, shader, sampler);
+    }
+    rasterizer.resolve();
+}
+
+static void testMatchesSupersampling(q3::Rasterizer::AA_MODE ssaa, q3::Rasterizer::AA_MODE msaa)
+{
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(37, 29);
+    auto reference = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(37, 29);
+    q3::Rasterizer rasterizer(reference);
+    drawFan(rasterizer, ssaa);
+    rasterizer.setBuffers(framebuffer);
+    drawFan(rasterizer, msaa);
+
+    int mismatches = 0;
+    int edge_pixels = 0;
+    for (uint32_t y = 0; y < framebuffer->getHeight(); y++) {
+        for (uint32_t x = 0; x < framebuffer->getWidth(); x++) {
+            const q3::RGBColor& a = (*framebuffer)[y][x];
+            const q3::RGBColor& b = (*reference)[y][x];
+            if (a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a) mismatches++;
+            // a sector partly covering the background
+            if (b.b != 0 && b.b != 200) edge_pixels++;
+        }
+    }
+    EXPECT(edge_pixels > 0);
+    EXPECT(mismatches == 0);
+}
+
+int main()
+{
+    using AA_MODE = q3::Rasterizer::AA_MODE;
+    testMatchesSupersampling(AA_MODE::SSAA_2X, AA_MODE::MSAA_2X);
+    testMatchesSupersampling(AA_MODE::SSAA_4X, AA_MODE::MSAA_4X);
+    testMatchesSupersampling(AA_MODE::SSAA_8X, AA_MODE::MSAA_8X);
+    testMatchesSupersampling(AA_MODE::SSAA_16X, AA_MODE::MSAA_16X);
+    if (failures == 0) std::printf("MSAA: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Output bytes of HalfBlockEncoder and PixelMatrix
+#include "../lib/PixelMatrix/PixelMatrix.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct Pixel {
+    uint8_t r, g, b, a;
+};
+
+static const Pixel kRed{255, 0, 0, 255};
+static const Pixel kGreen{0, 255, 0, 255};
+static const Pixel kBlue{16, 32, 48, 255};
+static const Pixel kClear{0, 0, 0, 0};
+
+static int failures = 0;
+
+static std::string escape(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '\033') out += "\\e";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+static void expectBytes(const char* name, const std::string& actual, const std::string& expected)
+{
+    if (actual == expected) return;
+    failures++;
+    std::printf("FAIL %s\n  expected: %s\n  actual:   %s\n", name, escape(expected).c_str(), escape(actual).c_str());
+}
+
+// a matrix of 'rows' pixel rows filled from one string per row: 'r' red, 'g' green, '.' transparent
+static PixelMatrix makeMatrix(const std::vector<std::string>& rows)
+{
+    const int height = static_cast<int>(rows.size());
+    const int width = static_cast<int>(rows[0].size());
+    std::vector<std::vector<Pixel>> pixels(height, std::vector<Pixel>(width));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            char c = rows[y][x];
+            pixels[y][x] = c == 'r' ? kRed : c == 'g' ? kGreen : kClear;
+        }
+    }
+    PixelMatrix matrix(height, width);
+    for (int y = 0; y < height; y += 2) matrix.setLine(y >> 1, pixels[y].data(), y + 1 < height ? pixels[y + 1].data() : nullptr);
+    return matrix;
+}
+
+static void testCells()
+{
+    HalfBlockEncoder encoder;
+    std::string out;
+    // a solid cell is a space on its background
+    encoder.putCell(HalfBlockEncoder::makeCell(kBlue, &kBlue), out);
+    // two colors: upper half block in the top color over the bottom color
+    encoder.putCell(HalfBlockEncoder::makeCell(kRed, &kBlue), out);
+    // a lone bottom pixel on the default background
+    encoder.putCell(HalfBlockEncoder::makeCell(kClear, &kRed), out);
+    encoder.endLine(out);
+    expectBytes("cells", out, "\033[48;2;16;32;48m \033[38;2;255;0;0m▀\033[49m▄\033[39;49m");
+}
+
+static void testRuns()
+{
+    const HalfBlockCell upper = HalfBlockEncoder::makeCell(kRed, &kClear);
+    const HalfBlockCell solid = HalfBlockEncoder::makeCell(kRed, &kRed);
+
+    HalfBlockEncoder repeat(true);
+    std::string out;
+    repeat.putRun(upper, 10, out);
+    expectBytes("run with REP", out, "\033[38;2;255;0;0m▀\033[9b");
+
+    // REP only where it is shorter than the repeated glyphs
+    out.clear();
+    repeat.beginLine();
+    repeat.putRun(solid, 4, out);
+    expectBytes("short run with REP", out, "\033[48;2;255;0;0m    ");
+
+    HalfBlockEncoder plain;
+    out.clear();
+    plain.putRun(upper, 3, out);
+    expectBytes("run without REP", out, "\033[38;2;255;0;0m▀▀▀");
+}
+
+static void testWrite()
+{
+    std::string out;
+    HalfBlockEncoder encoder;
+    // more than 3 trailing blanks are erased with EL, fewer are written
+    makeMatrix({"r.......", "r......."}).write(encoder, out);
+    makeMatrix({"r...", "r..."}).write(encoder, out);
+    expectBytes("write", out, "\033[48;2;255;0;0m \033[49m\033[K\n\033[48;2;255;0;0m \033[49m   \n");
+
+    // the last line of an odd height only has top pixels
+    out.clear();
+    makeMatrix({"rr", "gg", "rr"}).write(encoder, out);
+    expectBytes("write odd height", out, "\033[38;2;255;0;0m\033[48;2;0;255;0m▀▀\033[39;49m\n\033[38;2;255;0;0m▀▀\033[39;49m\n");
+}
+
+static void testDelta()
+{
+    HalfBlockEncoder encoder;
+    const PixelMatrix shown = makeMatrix({"rrrrrrrr", "rrrrrrrr", "rrrrrrrr", "rrrrrrrr"});
+
+    // nothing changed: the cursor only moves below the last line
+    std::string out;
+    shown.writeDelta(shown, encoder, out);
+    expectBytes("delta unchanged", out, "\n\n");
+
+    // one cell of the second line: skip the first line and the unchanged cells
+    out.clear();
+    makeMatrix({"rrrrrrrr", "rrrrrrrr", "rrrgrrrr", "rrrrrrrr"}).writeDelta(shown, encoder, out);
+    expectBytes("delta one cell", out, "\n\033[3C\033[38;2;0;255;0m\033[48;2;255;0;0m▀\033[39;49m\n");
+
+    // a line that became blank at its end is erased with EL
+    out.clear();
+    makeMatrix({"rr......", "rr......", "rrrrrrrr", "rrrrrrrr"}).writeDelta(shown, encoder, out);
+    expectBytes("delta erased tail", out, "\033[2C\033[K\n\n");
+
+    // a different size is written in full
+    out.clear();
+    makeMatrix({"r", "r"}).writeDelta(shown, encoder, out);
+    expectBytes("delta resized", out, "\033[48;2;255;0;0m \033[39;49m\n");
+}
+
+int main()
+{
+    testCells();
+    testRuns();
+    testWrite();
+    testDelta();
+    if (failures == 0) std::printf("PixelMatrix: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
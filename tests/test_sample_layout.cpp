@@ -0,0 +1,114 @@
+// Every sample layout resolves to the same bytes as the interleaved one
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include "../lib/Q3Engine/Shader.hpp"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+// a color per vertex, interpolated across the triangle, so samples of one pixel differ
+class GradientShader : public q3::Shader {
+public:
+    q3::RGBColor colors[3];
+    std::size_t getContextSize() const override { return 0; }
+    bool vertexShader(q3::Vertex&, q3::Vertex&, q3::Vertex&, void*, void*, void*, void*) override { return true; }
+    q3::RGBColor fragmentShader(const q3::Triangle&, const q3::Barycentric& b, void*, void*, void*, const void*) override
+    {
+        auto mix = [&](uint8_t c0, uint8_t c1, uint8_t c2) { return static_cast<uint8_t>(c0 * b.l0 + c1 * b.l1 + c2 * b.l2 + 0.5f); };
+        return q3::RGBColor(mix(colors[0].r, colors[1].r, colors[2].r), mix(colors[0].g, colors[1].g, colors[2].g),
+                            mix(colors[0].b, colors[1].b, colors[2].b), mix(colors[0].a, colors[1].a, colors[2].a));
+    }
+};
+
+static void drawTriangle(q3::Rasterizer& rasterizer, q3::Vector3 v0, q3::Vector3 v1, q3::Vector3 v2, q3::RGBColor c0, q3::RGBColor c1, q3::RGBColor c2)
+{
+    GradientShader shader;
+    shader.colors[0] = c0;
+    shader.colors[1] = c1;
+    shader.colors[2] = c2;
+    q3::DummyDataBufferSampler sampler;
+    q3::DataBuffer<q3::Vector3> vertices{v0, v1, v2};
+    q3::DataBuffer<uint32_t> indices{0, 1, 2};
+    rasterizer.drawBuffer(vertices, indices, shader, sampler);
+}
+
+// opaque and translucent triangles, a full resolve, then a scissored redraw of part of
+// the frame resolved alone, and translucent samples resolved over the output
+static void drawScene(q3::Rasterizer& rasterizer)
+{
+    const q3::RGBColor background(24, 24, 24, 0);
+    rasterizer.clearFrameBuffer(background);
+    for (uint32_t i = 0; i < 5; i++) {
+        const float a0 = 2.0f * 3.14159265f * i / 5 + 0.2f;
+        const float a1 = 2.0f * 3.14159265f * (i + 1) / 5 + 0.2f;
+        drawTriangle(rasterizer, {0.05f, 0.0f, 0.0f}, {0.9f * std::cos(a0), 0.9f * std::sin(a0), 0.0f}, {0.9f * std::cos(a1), 0.9f * std::sin(a1), 0.0f},
+                     q3::RGBColor(250, 10, 40 * i, 255), q3::RGBColor(10, 250, 0, 255), q3::RGBColor(60 * i, 90, 250, 255));
+    }
+    drawTriangle(rasterizer, {-0.7f, -0.6f, 0.0f}, {0.8f, -0.2f, 0.0f}, {-0.1f, 0.75f, 0.0f},
+                 q3::RGBColor(255, 255, 255, 200), q3::RGBColor(0, 0, 0, 90), q3::RGBColor(255, 0, 128, 33));
+    rasterizer.resolve();
+
+    const q3::Rect region{5, 3, 22, 17};
+    q3::Rasterizer::DrawState state = rasterizer.getDrawState();
+    state.scissor_test = true;
+    state.scissor = region;
+    rasterizer.setDrawState(state);
+    rasterizer.clearFrameBuffer(background, region);
+    drawTriangle(rasterizer, {-1.0f, 1.0f, 0.0f}, {0.3f, 0.9f, 0.0f}, {-0.6f, -0.3f, 0.0f},
+                 q3::RGBColor(30, 200, 90, 255), q3::RGBColor(200, 30, 90, 120), q3::RGBColor(90, 30, 200, 255));
+    rasterizer.resolve(region);
+
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 0), region);
+    drawTriangle(rasterizer, {-0.9f, 0.1f, 0.0f}, {0.1f, 0.95f, 0.0f}, {0.2f, -0.1f, 0.0f},
+                 q3::RGBColor(255, 200, 0, 170), q3::RGBColor(0, 80, 255, 60), q3::RGBColor(255, 255, 255, 255));
+    rasterizer.resolveOver(region);
+}
+
+// the scene in a 37x29 frame: not a multiple of any tile size, so partial tiles and rows are covered
+static std::shared_ptr<q3::GraphicsBuffer<q3::RGBColor>> render(q3::Rasterizer::AA_MODE mode, q3::Rasterizer::SampleLayout layout)
+{
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(37, 29);
+    q3::Rasterizer rasterizer(framebuffer);
+    rasterizer.setAntialiasingMode(mode);
+    rasterizer.setSampleLayout(layout);
+    drawScene(rasterizer);
+    return framebuffer;
+}
+
+static void testLayouts(q3::Rasterizer::AA_MODE mode)
+{
+    using Layout = q3::Rasterizer::SampleLayout;
+    auto reference = render(mode, Layout::INTERLEAVED);
+    for (Layout layout : {Layout::PLANAR, Layout::TILED}) {
+        auto framebuffer = render(mode, layout);
+        int mismatches = 0;
+        for (uint32_t y = 0; y < framebuffer->getHeight(); y++) {
+            for (uint32_t x = 0; x < framebuffer->getWidth(); x++) {
+                const q3::RGBColor& a = (*framebuffer)[y][x];
+                const q3::RGBColor& b = (*reference)[y][x];
+                if (a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a) mismatches++;
+            }
+        }
+        EXPECT(mismatches == 0);
+    }
+}
+
+int main()
+{
+    using AA_MODE = q3::Rasterizer::AA_MODE;
+    for (AA_MODE mode : {AA_MODE::SSAA_2X, AA_MODE::SSAA_4X, AA_MODE::SSAA_8X, AA_MODE::SSAA_16X, AA_MODE::MSAA_4X, AA_MODE::MSAA_16X}) {
+        testLayouts(mode);
+    }
+    if (failures == 0) std::printf("Sample layouts: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}
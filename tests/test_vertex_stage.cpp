@@ -0,0 +1,142 @@
+// The per-vertex stage of drawBuffer against the per-triangle vertexShader path
+#include "../lib/Q3Engine/Buffer.hpp"
+#include "../lib/Q3Engine/Math.hpp"
+#include "../lib/Q3Engine/Rasterizer.hpp"
+#include "../lib/Q3Engine/Shader.hpp"
+#include <cstdio>
+#include <memory>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            failures++;                                                          \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+        }                                                                        \
+    } while (0)
+
+// transforms every triangle in vertexShader, and keeps the mean of its vertex colors as context;
+// the green channel is interpolated with perspective correction, so w must match too
+class TriangleShader : public q3::Shader {
+public:
+    std::size_t getContextSize() const override { return sizeof(q3::RGBColor); }
+    bool vertexShader(q3::Vertex& v0, q3::Vertex& v1, q3::Vertex& v2, void* data0, void* data1, void* data2, void* context) override
+    {
+        v0 = transform.dot(v0);
+        v1 = transform.dot(v1);
+        v2 = transform.dot(v2);
+        fillContext(data0, data1, data2, context);
+        return true;
+    }
+    q3::RGBColor fragmentShader(const q3::Triangle& triangle, const q3::Barycentric& barycentric, void* data0, void* data1, void* data2, const void* context) override
+    {
+        const q3::RGBColor& mean = *reinterpret_cast<const q3::RGBColor*>(context);
+        const float g = q3::Shader::perspectiveCorrectInterpolate(static_cast<float>(color(data0).g), static_cast<float>(color(data1).g),
+                                                                  static_cast<float>(color(data2).g), triangle, barycentric);
+        return q3::RGBColor(mean.r, static_cast<uint8_t>(g + 0.5f), mean.b, 255);
+    }
+
+    q3::Matrix4 transform;
+
+protected:
+    static const q3::RGBColor& color(void* data) { return *reinterpret_cast<const q3::RGBColor*>(data); }
+
+    static void fillContext(void* data0, void* data1, void* data2, void* context) {
+        *reinterpret_cast<q3::RGBColor*>(context) = q3::RGBColor(static_cast<uint8_t>((color(data0).r + color(data1).r + color(data2).r) / 3), 0,
+                                                                 static_cast<uint8_t>((color(data0).b + color(data1).b + color(data2).b) / 3), 255);
+    }
+};
+
+// the same shader, with the per-vertex stage
+class BatchedShader : public TriangleShader {
+public:
+    bool transformVertices(const q3::Vector3* positions, q3::Vertex* out, std::size_t count) override
+    {
+        q3::transformPoints(transform, positions, out, count);
+        return true;
+    }
+    void setupContext(void* data0, void* data1, void* data2, void* context) override { fillContext(data0, data1, data2, context); }
+};
+
+// a grid of shared vertices at varying depth, partly beyond the viewport
+static void drawGrid(q3::Rasterizer& rasterizer, TriangleShader& shader)
+{
+    constexpr uint32_t n = 7;
+    q3::DataBuffer<q3::Vector3> vertices;
+    auto colors = std::make_shared<q3::DataBuffer<q3::RGBColor>>();
+    q3::DataBuffer<uint32_t> indices;
+    for (uint32_t j = 0; j < n; j++) {
+        for (uint32_t i = 0; i < n; i++) {
+            vertices.push_back({-1.3f + 2.6f * i / (n - 1), -1.1f + 2.2f * j / (n - 1), 0.3f * ((i + 2 * j) % 5) / 5.0f - 0.2f});
+            colors->push_back(q3::RGBColor(static_cast<uint8_t>(37 * i), static_cast<uint8_t>(29 * j + 11 * i), static_cast<uint8_t>(255 - 31 * j), 255));
+        }
+    }
+    for (uint32_t j = 0; j + 1 < n; j++) {
+        for (uint32_t i = 0; i + 1 < n; i++) {
+            const uint32_t a = j * n + i;
+            indices.insert(indices.end(), {a, a + 1, a + n + 1, a, a + n + 1, a + n});
+        }
+    }
+    q3::DataBufferSampler<q3::RGBColor> sampler(colors);
+    rasterizer.drawBuffer(vertices, indices, shader, sampler);
+}
+
+static void testMatchesVertexShader(q3::Rasterizer::AA_MODE mode)
+{
+    // rotation, scale and a perspective row, so w differs between vertices
+    const q3::Matrix4 transform = {
+        {0.8f, -0.3f, 0.0f, 0.05f},
+        {0.3f, 0.8f, 0.1f, -0.02f},
+        {0.0f, 0.05f, 0.5f, 0.1f},
+        {0.1f, 0.05f, 0.2f, 1.0f}
+    };
+    TriangleShader triangle_shader;
+    BatchedShader batched_shader;
+    triangle_shader.transform = transform;
+    batched_shader.transform = transform;
+
+    auto reference = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(41, 33);
+    auto framebuffer = std::make_shared<q3::GraphicsBuffer<q3::RGBColor>>(41, 33);
+    auto depthbuffer = std::make_shared<q3::GraphicsBuffer<float>>(41, 33);
+    q3::Rasterizer rasterizer(reference, depthbuffer);
+    rasterizer.setAntialiasingMode(mode);
+    // no guard band: the triangles leaving the viewport take the clipping path
+    rasterizer.setGuardBand(1.0f);
+
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+    rasterizer.clearDepthBuffer();
+    drawGrid(rasterizer, triangle_shader);
+    rasterizer.resolve();
+    const q3::Rasterizer::TriangleStats reference_stats = rasterizer.getTriangleStats();
+
+    rasterizer.setBuffers(framebuffer, depthbuffer);
+    rasterizer.resetTriangleStats();
+    rasterizer.clearFrameBuffer(q3::RGBColor(0, 0, 0, 255));
+    rasterizer.clearDepthBuffer();
+    drawGrid(rasterizer, batched_shader);
+    rasterizer.resolve();
+    const q3::Rasterizer::TriangleStats& stats = rasterizer.getTriangleStats();
+
+    EXPECT(stats.submitted == reference_stats.submitted && stats.clipped == reference_stats.clipped);
+    EXPECT(stats.clipped > 0);
+    int mismatches = 0;
+    for (uint32_t y = 0; y < framebuffer->getHeight(); y++) {
+        for (uint32_t x = 0; x < framebuffer->getWidth(); x++) {
+            const q3::RGBColor& a = (*framebuffer)[y][x];
+            const q3::RGBColor& b = (*reference)[y][x];
+            if (a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a) mismatches++;
+        }
+    }
+    EXPECT(mismatches == 0);
+}
+
+int main()
+{
+    using AA_MODE = q3::Rasterizer::AA_MODE;
+    for (AA_MODE mode : {AA_MODE::NONE, AA_MODE::SSAA_4X, AA_MODE::MSAA_4X}) {
+        testMatchesVertexShader(mode);
+    }
+    if (failures == 0) std::printf("Vertex stage: all tests passed\n");
+    return failures == 0 ? 0 : 1;
+}